@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include "plget.h"
+#include "result.h"
+#include "trace.h"
+#include "hist.h"
+#include "base.h"
+#include "store.h"
+
+struct base_ctx {
+	struct trace t;
+	struct trace_src srcs[TRACE_COL_MAX];
+	int src_num;
+	int digits;
+	int regressed;
+};
+
+static char *base_name(struct base_ctx *c, struct stats *ss)
+{
+	int i;
+
+	for (i = 0; i < c->src_num; i++) {
+		if (c->srcs[i].ss == ss)
+			return c->srcs[i].name;
+	}
+
+	return "";
+}
+
+/* Kolmogorov distribution tail, Numerical Recipes' probks() */
+static double base_ks_p(double d, __u64 n1, __u64 n2)
+{
+	double ne = (double)n1 * n2 / (n1 + n2);
+	double l = (sqrt(ne) + 0.12 + 0.11 / sqrt(ne)) * d;
+	double t, sum = 0, sign = 2;
+	int j;
+
+	for (j = 1; j <= 100; j++) {
+		t = sign * exp(-2 * j * j * l * l);
+		sum += t;
+		if (fabs(t) <= 1e-10 * fabs(sum))
+			return sum < 0 ? 0 : sum > 1 ? 1 : sum;
+
+		sign = -sign;
+	}
+
+	/* not converged, for small distance only */
+	return 1;
+}
+
+/* distribution free bounds of percentile, by order statistic ranks */
+static void base_pct_bounds(struct hist *h, double pct, __s64 *lo,
+			    __s64 *hi)
+{
+	double p = pct / 100, n = h->n;
+	double k = n * p, dk = BASE_Z * sqrt(n * p * (1 - p));
+
+	*lo = hist_percentile(h, k - dk > 0 ? 100 * (k - dk) / n : 0);
+	*hi = hist_percentile(h, k + dk < n ? 100 * (k + dk) / n : 100);
+}
+
+static int base_tail(struct hist *h, double pct)
+{
+	return h->n * (1 - pct / 100) < BASE_TAIL_MIN;
+}
+
+/* current latencies of the link into h */
+static int base_cur_hist(struct stats_link *l, struct hist *h)
+{
+	struct stats tmp = {0};
+	__s64 *v;
+
+	if (l->hist)
+		return 0;
+
+	if (hist_init(h, BASE_DIGITS))
+		return -1;
+
+	/* same scratch as report, not limited by RAM with ts file */
+	v = store_scratch(plget->pkt_num);
+	if (!v) {
+		hist_free(h);
+		return -1;
+	}
+
+	stats_reserve_buf(&tmp, v, plget->pkt_num);
+	stats_diff(l->a, l->b, &tmp);
+	for (v = tmp.start_ts; v < tmp.next_ts; v++) {
+		if (*v)
+			hist_add(h, *v);
+	}
+
+	store_scratch_free(tmp.start_ts);
+	return 0;
+}
+
+static void base_link(struct stats_link *l, void *arg)
+{
+	__s64 blo, bhi, clo, chi, tol, *a, *b;
+	int i, pct_num, up = 0, down = 0;
+	double pct[STATS_PCT_MAX];
+	struct base_ctx *c = arg;
+	struct hist bh, ch, *cur;
+	double d, p;
+	__u64 k;
+
+	if (!l->name || !l->acc.n)
+		return;
+
+	a = trace_col(&c->t, base_name(c, l->a));
+	b = trace_col(&c->t, base_name(c, l->b));
+	if (!a || !b) {
+		printf("%s: not in baseline\n", l->name);
+		return;
+	}
+
+	/* same layout as current histogram, so they are compared bucketwise */
+	if (hist_init(&bh, l->hist ? c->digits : BASE_DIGITS))
+		return;
+
+	for (k = 0; k < c->t.hdr.rec_num; k++) {
+		if (a[k] && b[k])
+			hist_add(&bh, a[k] - b[k]);
+	}
+
+	cur = l->hist ? l->hist : &ch;
+	if (base_cur_hist(l, &ch)) {
+		printf("%s: no memory to compare with baseline\n", l->name);
+		hist_free(&bh);
+		return;
+	}
+
+	d = hist_ks(&bh, cur);
+	if (d < 0) {
+		printf("%s: no latencies in baseline\n", l->name);
+		goto out;
+	}
+
+	p = base_ks_p(d, bh.n, cur->n);
+	printf("%s: packets %llu -> %llu, KS D = %.4f, p = %.3g\n", l->name,
+	       bh.n, cur->n, d, p);
+
+	pct_num = stats_get_pct(pct);
+	for (i = 0; i < pct_num; i++) {
+		base_pct_bounds(&bh, pct[i], &blo, &bhi);
+		base_pct_bounds(cur, pct[i], &clo, &chi);
+
+		printf("p%g = %.2fus -> %.2fus, delta %+.2fus [%+.2f, %+.2f]",
+		       pct[i], hist_percentile(&bh, pct[i]) / 1000.0,
+		       hist_percentile(cur, pct[i]) / 1000.0,
+		       (hist_percentile(cur, pct[i]) -
+			hist_percentile(&bh, pct[i])) / 1000.0,
+		       (clo - bhi) / 1000.0, (chi - blo) / 1000.0);
+
+		/* tail is too short to bound the percentile */
+		if (base_tail(&bh, pct[i]) || base_tail(cur, pct[i])) {
+			printf(" (too few packets)\n");
+			continue;
+		}
+
+		printf("\n");
+
+		/* whole bounds of delta are beyond tolerance */
+		tol = llabs(hist_percentile(&bh, pct[i])) * BASE_TOL;
+		if (clo - bhi > tol)
+			up = 1;
+		if (chi - blo < -tol)
+			down = 1;
+	}
+
+	if (p >= BASE_ALPHA)
+		printf("%s: no significant change\n\n", l->name);
+	else if (up)
+		printf("%s: REGRESSED\n\n", l->name);
+	else if (down)
+		printf("%s: improved\n\n", l->name);
+	else
+		printf("%s: distribution changed, within %g%% tolerance\n\n",
+		       l->name, BASE_TOL * 100);
+
+	if (p < BASE_ALPHA && up)
+		c->regressed++;
+out:
+	hist_free(&bh);
+	if (!l->hist)
+		hist_free(&ch);
+}
+
+int base_compare(char *path)
+{
+	struct base_ctx *c;
+	int ret;
+
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return -ENOMEM;
+
+	ret = trace_read(path, &c->t);
+	if (ret) {
+		free(c);
+		return ret;
+	}
+
+	if (c->t.hdr.mode != plget->mod)
+		printf("baseline is of other mode, comparing same stages\n");
+
+	c->src_num = trace_collect(c->srcs);
+	c->digits = plget->hist_digits;
+
+	printf("\ncomparison to baseline %s, %llu packets:\n", path,
+	       c->t.hdr.rec_num);
+	res_for_each_link(base_link, c);
+
+	if (c->regressed)
+		printf("stages regressed: %d\n", c->regressed);
+	else
+		printf("no stage regressed\n");
+
+	ret = !!c->regressed;
+	trace_free(&c->t);
+	free(c);
+	return ret;
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef PLGET_BASE_H
+#define PLGET_BASE_H
+
+#define BASE_DIGITS		3	/* if no histogram backend precision */
+#define BASE_ALPHA		0.01	/* KS significance level */
+#define BASE_Z			2.576	/* 99% bounds of percentiles */
+#define BASE_TOL		0.05	/* smaller shift isn't a regression */
+#define BASE_TAIL_MIN		10	/* values above percentile to judge it */
+#define BASE_REGRESSED		3	/* exit code */
+
+/*
+ * Comparison of latencies to baseline run saved as binary trace (-y).
+ * Returns 1 if some stage regressed, 0 if not, < 0 on error.
+ */
+int base_compare(char *path);
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include "plget.h"
+#include "pkt_ring.h"
+#include "burst.h"
+
+#define BURST_CTL_SIZE		CMSG_SPACE(sizeof(__u64))
+
+static struct mmsghdr *b_msg;
+static struct iovec *b_iov;
+static char *b_pkt;
+static char *b_ctl;		/* SCM_TXTIME of each packet */
+
+static void burst_id_wr(char *pkt, __u32 id)
+{
+	if (plget->flags & PLF_PTP)
+		pkt_sid_wr(pkt, htons((id & SEQ_ID_MASK) | plget->stream_id));
+
+	pkt_tid_wr(pkt, id);
+}
+
+int burst_init(void)
+{
+	int dsize = plget->sk_payload_size;
+	int num = plget->burst;
+	struct cmsghdr *cmsg;
+	struct msghdr *hdr;
+	int i;
+
+	/* frames are in the ring already */
+	if (plget->flags & PLF_TX_RING)
+		return 0;
+
+	b_pkt = malloc(num * dsize);
+	b_msg = calloc(num, sizeof(*b_msg));
+	b_iov = calloc(num, sizeof(*b_iov));
+	b_ctl = calloc(num, BURST_CTL_SIZE);
+	if (!b_pkt || !b_msg || !b_iov || !b_ctl)
+		return printf("Couldn't allocate burst\n"), -ENOMEM;
+
+	for (i = 0; i < num; i++) {
+		memcpy(b_pkt + i * dsize, plget->pkt, dsize);
+		b_iov[i].iov_base = b_pkt + i * dsize;
+		b_iov[i].iov_len = dsize;
+
+		hdr = &b_msg[i].msg_hdr;
+		hdr->msg_name = &plget->sk_addr;
+		hdr->msg_namelen = sizeof(plget->sk_addr);
+		hdr->msg_iov = &b_iov[i];
+		hdr->msg_iovlen = 1;
+
+		if (!plget->txtime_lead)
+			continue;
+
+		hdr->msg_control = b_ctl + i * BURST_CTL_SIZE;
+		hdr->msg_controllen = BURST_CTL_SIZE;
+		cmsg = CMSG_FIRSTHDR(hdr);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_TXTIME;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(__u64));
+	}
+
+	return 0;
+}
+
+void burst_free(void)
+{
+	free(b_pkt);
+	free(b_msg);
+	free(b_iov);
+	free(b_ctl);
+	b_pkt = b_ctl = NULL;
+	b_msg = NULL;
+	b_iov = NULL;
+}
+
+/* whole burst is queued first, kernel is kicked once */
+static int burst_ring_send(__u32 id, int num)
+{
+	int i, ret;
+
+	for (i = 0; i < num; i++) {
+		burst_id_wr(plget->pkt, id + i);
+		ret = pkt_ring_queue();
+		if (ret)
+			return ret;
+	}
+
+	ret = pkt_ring_flush();
+	return ret ? ret : num;
+}
+
+/* burst_send - send num packets with ids from id, all for same launch time */
+int burst_send(__u32 id, int num, __u64 txtime)
+{
+	int dsize = plget->sk_payload_size;
+	struct msghdr *hdr;
+	int i, ret;
+
+	if (plget->flags & PLF_TX_RING)
+		return burst_ring_send(id, num);
+
+	for (i = 0; i < num; i++) {
+		hdr = &b_msg[i].msg_hdr;
+		burst_id_wr(hdr->msg_iov->iov_base, id + i);
+		if (txtime)
+			memcpy(CMSG_DATA(CMSG_FIRSTHDR(hdr)), &txtime,
+			       sizeof(txtime));
+	}
+
+	ret = sendmmsg(plget->sfd, b_msg, num, 0);
+	if (ret < 0)
+		return perror("sendmmsg"), -errno;
+
+	for (i = 0; i < ret; i++) {
+		if (b_msg[i].msg_len != dsize)
+			break;
+	}
+
+	return i;
+}
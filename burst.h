@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef PLGET_BURST_H
+#define PLGET_BURST_H
+
+#include <linux/types.h>
+
+#define BURST_MAX		1024
+
+/*
+ * Burst of back-to-back packets per send slot, for CBS/taprio shaping
+ * tests. Packets are copies of plget->pkt with own ids submitted with one
+ * sendmmsg, or tx ring frames kicked once. Returns packets sent.
+ */
+int burst_init(void);
+void burst_free(void);
+int burst_send(__u32 id, int num, __u64 txtime);
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include "plget.h"
+#include "hist.h"
+#include "phc.h"
+#include "clk.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define CLK_DIGITS		3
+#define CLK_NUM(a)		((int)(sizeof(a) / sizeof((a)[0])))
+#define CLK_WARMUP		100	/* reads before measured ones */
+#define CLK_CAL			10000000	/* counter calibration, ns */
+#define CLK_SRC_FILE	"/sys/devices/system/clocksource/clocksource0/" \
+			"current_clocksource"
+
+enum clk_path {
+	CLK_VDSO,		/* libc, vDSO if clocksource allows */
+	CLK_SYSCALL,
+	CLK_COUNTER,		/* TSC or ARM generic counter */
+};
+
+static const char * const clk_path_name[] = {"vdso", "syscall", "direct"};
+
+/*
+ * Clock read benchmark. Back-to-back reads are taken, step between two
+ * consecutive values is a cost of one read as seen by the clock itself,
+ * so it's quantized by clock resolution, mean over whole run is not.
+ * Negative step is a monotonicity violation, zero one - read within
+ * same clock tick.
+ */
+struct clk_res {
+	struct hist cost;
+	double mean;
+	__s64 step;		/* smallest non-zero step */
+	__u64 back;
+	__u64 same;
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CLK_COUNTER_NAME	"TSC"
+
+static inline __u64 clk_counter(void)
+{
+	return __rdtsc();
+}
+#elif defined(__aarch64__)
+#define CLK_COUNTER_NAME	"CNTVCT"
+
+static inline __u64 clk_counter(void)
+{
+	__u64 c;
+
+	asm volatile("isb; mrs %0, cntvct_el0" : "=r" (c) :: "memory");
+	return c;
+}
+#else
+#define CLK_COUNTER_NAME	"counter"
+
+static inline __u64 clk_counter(void)
+{
+	return 0;
+}
+#endif
+
+static inline __s64 clk_ns(struct timespec *ts)
+{
+	return (__s64)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static inline __s64 clk_read(clockid_t clk, enum clk_path path)
+{
+	struct timespec ts;
+
+	switch (path) {
+	case CLK_VDSO:
+		clock_gettime(clk, &ts);
+		break;
+	case CLK_SYSCALL:
+		syscall(SYS_clock_gettime, clk, &ts);
+		break;
+	default:
+		return clk_counter();
+	}
+
+	return clk_ns(&ts);
+}
+
+/* ns per counter tick, 0 if there is no counter */
+static double clk_counter_ns(void)
+{
+	struct timespec cal = {0, CLK_CAL};
+	struct timespec t1, t2;
+	__u64 c1, c2;
+
+#if defined(__aarch64__)
+	__u64 frq;
+
+	asm volatile("mrs %0, cntfrq_el0" : "=r" (frq));
+	return frq ? (double)NSEC_PER_SEC / frq : 0;
+#endif
+
+	/* TSC frequency isn't exposed, measure it against monotonic clock */
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	c1 = clk_counter();
+	nanosleep(&cal, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	c2 = clk_counter();
+
+	if (c2 <= c1)
+		return 0;
+
+	return (double)(clk_ns(&t2) - clk_ns(&t1)) / (c2 - c1);
+}
+
+static int clk_run(clockid_t clk, enum clk_path path, double tick,
+		   __s64 *v, int reads, struct clk_res *r)
+{
+	__s64 d;
+	int i;
+
+	for (i = 0; i < CLK_WARMUP; i++)
+		v[0] = clk_read(clk, path);
+
+	for (i = 0; i < reads; i++)
+		v[i] = clk_read(clk, path);
+
+	if (hist_init(&r->cost, CLK_DIGITS))
+		return -1;
+
+	r->step = 0;
+	r->back = 0;
+	r->same = 0;
+	r->mean = (double)(v[reads - 1] - v[0]) * tick / (reads - 1);
+
+	for (i = 1; i < reads; i++) {
+		d = (v[i] - v[i - 1]) * tick;
+		if (d < 0) {
+			r->back++;
+			continue;
+		}
+
+		if (!d)
+			r->same++;
+		else if (!r->step || d < r->step)
+			r->step = d;
+
+		hist_add(&r->cost, d);
+	}
+
+	return 0;
+}
+
+static void clk_print(char *name, enum clk_path path, struct clk_res *r)
+{
+	printf("%-16s %-8s %6lld %8.1f %7lld %7lld %7lld %9lld %8llu %8llu\n",
+	       name, clk_path_name[path], r->step, r->mean,
+	       hist_percentile(&r->cost, 50), hist_percentile(&r->cost, 99),
+	       hist_percentile(&r->cost, 99.9), r->cost.max, r->back, r->same);
+}
+
+static void clk_bench_one(clockid_t clk, char *name, enum clk_path path,
+			  double tick, __s64 *v, int reads)
+{
+	struct clk_res r;
+
+	if (clk_run(clk, path, tick, v, reads, &r)) {
+		printf("%-16s %-8s no memory\n", name, clk_path_name[path]);
+		return;
+	}
+
+	clk_print(name, path, &r);
+	hist_free(&r.cost);
+}
+
+static void clk_source_print(void)
+{
+	char src[32] = "unknown";
+	FILE *f;
+
+	f = fopen(CLK_SRC_FILE, "r");
+	if (f) {
+		if (fgets(src, sizeof(src), f))
+			src[strcspn(src, "\n")] = '\0';
+		fclose(f);
+	}
+
+	printf("clocksource: %s\n", src);
+}
+
+/*
+ * clk_bench - read cost and resolution of system clocks, PHC if phc_fd
+ * isn't negative and of raw cpu counter, reads per clock and path.
+ */
+void clk_bench(int phc_fd, char *phc_name, int reads)
+{
+	static const struct {
+		clockid_t id;
+		char *name;
+	} sys_clk[] = {
+		{CLOCK_REALTIME, "CLOCK_REALTIME"},
+		{CLOCK_MONOTONIC, "CLOCK_MONOTONIC"},
+		{CLOCK_TAI, "CLOCK_TAI"},
+	};
+	struct timespec ts;
+	double tick;
+	__s64 *v;
+	int i;
+
+	if (reads < 2)
+		reads = 2;
+
+	v = malloc(reads * sizeof(*v));
+	if (!v) {
+		perror("clock bench");
+		return;
+	}
+
+	printf("-----------------------------------------\n");
+	clk_source_print();
+	clock_gettime(CLOCK_REALTIME, &ts);
+	printf("Current time: %lluns\n", (__u64)clk_ns(&ts));
+
+	printf("Declared resolution:");
+	for (i = 0; i < CLK_NUM(sys_clk); i++) {
+		clock_getres(sys_clk[i].id, &ts);
+		printf(" %s %lldns%s", sys_clk[i].name, clk_ns(&ts),
+		       i < CLK_NUM(sys_clk) - 1 ? "," : "\n");
+	}
+
+	printf("Read cost, %d back-to-back reads, ns:\n", reads);
+	printf("%-16s %-8s %6s %8s %7s %7s %7s %9s %8s %8s\n", "clock", "path",
+	       "step", "mean", "p50", "p99", "p99.9", "max", "back", "same");
+
+	for (i = 0; i < CLK_NUM(sys_clk); i++) {
+		clk_bench_one(sys_clk[i].id, sys_clk[i].name, CLK_VDSO, 1,
+			      v, reads);
+		clk_bench_one(sys_clk[i].id, sys_clk[i].name, CLK_SYSCALL, 1,
+			      v, reads);
+	}
+
+	/* dynamic posix clocks are never served by vDSO */
+	if (phc_fd >= 0) {
+		clk_bench_one(PHC_CLOCKID(phc_fd), phc_name, CLK_SYSCALL, 1,
+			      v, reads);
+	}
+
+	tick = clk_counter_ns();
+	if (tick)
+		clk_bench_one(0, CLK_COUNTER_NAME, CLK_COUNTER, tick, v, reads);
+
+	free(v);
+}
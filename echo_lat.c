@@ -24,6 +24,7 @@
 #include "tx_lat.h"
 #include "rx_lat.h"
 #include "echo_lat.h"
+#include "pacer.h"
 #include <poll.h>
 #include <errno.h>
 
@@ -35,8 +36,8 @@ static int echolat_proc(void)
 	int type = plget->pkt_type;
 	int swap_addr, timer, ret;
 	struct ether_header *eth;
+	uint64_t exps, slot = 0;
 	struct pollfd fds;
-	uint64_t exps;
 
 	timer = ts_correct(&plget->interval);
 	if (timer) {
@@ -50,9 +51,19 @@ static int echolat_proc(void)
 
 	swap_addr = type == PKT_XDP || type == PKT_RAW;
 
-	plget->inum = plget->pkt_num;
-	for (plget->icnt = 0; plget->icnt < plget->pkt_num; ++plget->icnt) {
-		rxlat_proc_packet();
+	/* continuous mode if no packet num */
+	plget->inum = plget->pkt_num ? plget->pkt_num : ~0;
+	for (plget->icnt = 0; plget->icnt < plget->inum && !plget->stop;
+	     ++plget->icnt) {
+		ret = rxlat_proc_packet();
+		if (ret == -ETIME) {
+			printf("no packets for %dms, stop waiting\n",
+			       plget->rx_timeout);
+			break;
+		}
+
+		if (ret == -EINTR)
+			break;
 
 		plget->pkt = plget->rx_pkt;
 
@@ -71,12 +82,17 @@ static int echolat_proc(void)
 
 		if (timer) {
 			ret = poll(&fds, 1, MAX_LATENCY);
+			if (ret < 0 && errno == EINTR)
+				break;
 			if (ret <= 0)
 				return perror("Some error on timer poll()"), -errno;
 
 			ret = read(plget->timer_fd, &exps, sizeof(exps));
 			if (ret < 0)
 				return perror("Couldn't read timerfd"), -errno;
+
+			pacer_wait(slot);
+			slot += exps;
 		}
 
 		txlat_proc_packet();
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include <math.h>
+#include <string.h>
+#include "fmt.h"
+
+#define FMT_PREC		6	/* %g default precision */
+#define FMT_EXACT_MAX		(1LL << 53)	/* exact in double */
+
+/* round-half case of ns / 1000.0: 1 - up, 0 - down, as printf does it */
+static int fmt_tie_up(__s64 ns, __u64 q)
+{
+	double d = fabs(ns / 1000.0);
+	double r = fma(d, 1000.0, -(double)(ns < 0 ? -ns : ns));
+
+	/* printed double is off the decimal tie, or exactly on it */
+	if (r)
+		return r > 0;
+
+	return q & 1;
+}
+
+/*
+ * fmt_us - printf("%g", ns / 1000.0) to s, w/o terminating 0, returns
+ * length. Digits are taken from ns exactly, ns / 1000.0 differs from it by
+ * less than the distance to the nearest rounding point, but for ties.
+ */
+int fmt_us(char *s, __s64 ns)
+{
+	char d[FMT_PREC], *p = s;
+	int i, l, x, end;
+	__u64 u, q, pw, r;
+
+	if (!ns) {
+		*p = '0';
+		return 1;
+	}
+
+	if (ns <= -FMT_EXACT_MAX || ns >= FMT_EXACT_MAX)
+		return snprintf(s, FMT_G_MAX, "%g", ns / 1000.0);
+
+	u = ns < 0 ? -ns : ns;
+	for (l = 1, pw = 1; pw <= u / 10; l++)
+		pw *= 10;
+
+	/* leading digit is 10^x of us */
+	x = l - 4;
+	q = u;
+	if (l > FMT_PREC) {
+		for (pw = 1, i = FMT_PREC; i < l; i++)
+			pw *= 10;
+
+		q = u / pw;
+		r = u % pw;
+		if (r > pw / 2 || (r == pw / 2 && fmt_tie_up(ns, q)))
+			q++;
+
+		if (q == 1000000) {
+			q = 100000;
+			x++;
+		}
+	} else {
+		for (i = l; i < FMT_PREC; i++)
+			q *= 10;
+	}
+
+	for (i = FMT_PREC - 1; i >= 0; i--, q /= 10)
+		d[i] = '0' + q % 10;
+
+	for (end = FMT_PREC; d[end - 1] == '0'; end--)
+		;
+
+	if (ns < 0)
+		*p++ = '-';
+
+	if (x < -4 || x >= FMT_PREC) {
+		*p++ = d[0];
+		if (end > 1) {
+			*p++ = '.';
+			memcpy(p, d + 1, end - 1);
+			p += end - 1;
+		}
+
+		*p++ = 'e';
+		*p++ = x < 0 ? '-' : '+';
+		x = x < 0 ? -x : x;
+		if (x >= 100)
+			*p++ = '0' + x / 100;
+		*p++ = '0' + x / 10 % 10;
+		*p++ = '0' + x % 10;
+	} else if (x >= 0) {
+		memcpy(p, d, x + 1);
+		p += x + 1;
+		if (end > x + 1) {
+			*p++ = '.';
+			memcpy(p, d + x + 1, end - x - 1);
+			p += end - x - 1;
+		}
+	} else {
+		*p++ = '0';
+		*p++ = '.';
+		for (i = x + 1; i < 0; i++)
+			*p++ = '0';
+		memcpy(p, d, end);
+		p += end;
+	}
+
+	return p - s;
+}
+
+void fmt_init(struct fmt_buf *b, FILE *f)
+{
+	b->f = f;
+	b->len = 0;
+}
+
+void fmt_flush(struct fmt_buf *b)
+{
+	fwrite(b->buf, 1, b->len, b->f);
+	b->len = 0;
+}
+
+void fmt_str(struct fmt_buf *b, const char *str, size_t len)
+{
+	if (b->len + len > FMT_BUF_SIZE) {
+		fmt_flush(b);
+		if (len > FMT_BUF_SIZE) {
+			fwrite(str, 1, len, b->f);
+			return;
+		}
+	}
+
+	memcpy(b->buf + b->len, str, len);
+	b->len += len;
+}
+
+/* %*g of ns / 1000.0, right aligned in width, 0 - no padding */
+void fmt_g(struct fmt_buf *b, __s64 ns, int width)
+{
+	char *p;
+	int n;
+
+	if (b->len + FMT_G_MAX + width > FMT_BUF_SIZE)
+		fmt_flush(b);
+
+	p = b->buf + b->len;
+	n = fmt_us(p, ns);
+	if (n < width) {
+		memmove(p + width - n, p, n);
+		memset(p, ' ', width - n);
+		n = width;
+	}
+
+	b->len += n;
+}
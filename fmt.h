@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef PLGET_FMT_H
+#define PLGET_FMT_H
+
+#include <stdio.h>
+#include <linux/types.h>
+
+#define FMT_G_MAX		32	/* longest fmt_us() string, w/o pad */
+#define FMT_BUF_SIZE		(64 << 10)
+
+/*
+ * Fast text output for per-packet dumps. Numbers are formatted from
+ * integers w/o printf, byte to byte same as printf("%g", ns / 1000.0).
+ */
+struct fmt_buf {
+	FILE *f;
+	size_t len;
+	char buf[FMT_BUF_SIZE];
+};
+
+int fmt_us(char *s, __s64 ns);
+void fmt_init(struct fmt_buf *b, FILE *f);
+void fmt_flush(struct fmt_buf *b);
+void fmt_str(struct fmt_buf *b, const char *str, size_t len);
+void fmt_g(struct fmt_buf *b, __s64 ns, int width);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "hist.h"
+
+int hist_init(struct hist *h, int digits)
+{
+	int half;
+
+	if (digits < HIST_MIN_DIGITS || digits > HIST_MAX_DIGITS)
+		return -1;
+
+	/* 2 * 10^digits sub-buckets is enough for the requested precision */
+	h->sub_bits = ceil(log2(2 * pow(10, digits)));
+	half = 1 << (h->sub_bits - 1);
+	h->bucket_num = (1 << h->sub_bits) +
+			(HIST_MAX_BITS - h->sub_bits) * half;
+
+	h->cnt = calloc(h->bucket_num, sizeof(*h->cnt));
+	if (!h->cnt)
+		return -1;
+
+	hist_reset(h);
+	return 0;
+}
+
+void hist_reset(struct hist *h)
+{
+	memset(h->cnt, 0, h->bucket_num * sizeof(*h->cnt));
+	h->n = 0;
+	h->neg = 0;
+	h->ovf = 0;
+	h->min = 0;
+	h->max = 0;
+	h->sum = 0;
+	h->sum2 = 0;
+}
+
+static int hist_idx(struct hist *h, __u64 val)
+{
+	int half = 1 << (h->sub_bits - 1);
+	int shift;
+
+	if (!(val >> h->sub_bits))
+		return val;
+
+	shift = 64 - __builtin_clzll(val) - h->sub_bits;
+	return (1 << h->sub_bits) + (shift - 1) * half +
+	       (val >> shift) - half;
+}
+
+/* middle of the bucket value range */
+static __s64 hist_val(struct hist *h, int idx)
+{
+	int half = 1 << (h->sub_bits - 1);
+	int shift, sub;
+
+	if (idx < (1 << h->sub_bits))
+		return idx;
+
+	idx -= 1 << h->sub_bits;
+	shift = idx / half + 1;
+	sub = idx % half + half;
+
+	return ((__s64)sub << shift) + (1LL << (shift - 1));
+}
+
+void hist_add(struct hist *h, __s64 val)
+{
+	__u64 v;
+
+	if (!h->n++) {
+		h->min = val;
+		h->max = val;
+	} else if (val < h->min) {
+		h->min = val;
+	} else if (val > h->max) {
+		h->max = val;
+	}
+
+	h->sum += val;
+	h->sum2 += (double)val * val;
+
+	if (val < 0) {
+		h->neg++;
+		v = 0;
+	} else if (val >= 1LL << HIST_MAX_BITS) {
+		h->ovf++;
+		v = (1LL << HIST_MAX_BITS) - 1;
+	} else {
+		v = val;
+	}
+
+	h->cnt[hist_idx(h, v)]++;
+}
+
+double hist_mean(struct hist *h)
+{
+	return h->n ? h->sum / h->n : 0;
+}
+
+double hist_dev(struct hist *h)
+{
+	double mean, var;
+
+	if (!h->n)
+		return 0;
+
+	mean = hist_mean(h);
+	var = h->sum2 / h->n - mean * mean;
+
+	return var > 0 ? sqrt(var) : 0;
+}
+
+__s64 hist_percentile(struct hist *h, double pct)
+{
+	__u64 rank, sum = 0;
+	__s64 val;
+	int i;
+
+	if (!h->n)
+		return 0;
+
+	rank = ceil(pct * h->n / 100);
+	if (!rank)
+		return h->min;
+
+	if (rank >= h->n)
+		return h->max;
+
+	for (i = 0; i < h->bucket_num; i++) {
+		sum += h->cnt[i];
+		if (sum >= rank)
+			break;
+	}
+
+	val = hist_val(h, i);
+	if (val < h->min)
+		return h->min;
+	if (val > h->max)
+		return h->max;
+
+	return val;
+}
+
+/*
+ * hist_cumulative - number of values not greater than each of ascending le,
+ * within bucket precision. Can be called while the histogram is fed.
+ */
+void hist_cumulative(struct hist *h, __s64 *le, int num, __u64 *cnt)
+{
+	__u64 v, sum = 0;
+	int i, k, idx;
+
+	for (i = 0, k = 0; k < num; k++) {
+		v = le[k] < 1LL << HIST_MAX_BITS ? le[k] :
+		    (1LL << HIST_MAX_BITS) - 1;
+		idx = le[k] < 0 ? -1 : hist_idx(h, v);
+		for (; i <= idx; i++)
+			sum += __atomic_load_n(&h->cnt[i], __ATOMIC_RELAXED);
+
+		cnt[k] = sum;
+	}
+}
+
+/*
+ * hist_ks - Kolmogorov-Smirnov distance, max difference of CDFs of a and
+ * b, both have to be of same digits. -1 if can't be compared.
+ */
+double hist_ks(struct hist *a, struct hist *b)
+{
+	__u64 ca = 0, cb = 0;
+	double d, max = 0;
+	int i;
+
+	if (!a->n || !b->n || a->sub_bits != b->sub_bits)
+		return -1;
+
+	for (i = 0; i < a->bucket_num; i++) {
+		ca += a->cnt[i];
+		cb += b->cnt[i];
+		d = fabs((double)ca / a->n - (double)cb / b->n);
+		if (d > max)
+			max = d;
+	}
+
+	return max;
+}
+
+void hist_free(struct hist *h)
+{
+	free(h->cnt);
+	h->cnt = NULL;
+}
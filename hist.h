@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef PLGET_HIST_H
+#define PLGET_HIST_H
+
+#include <linux/types.h>
+
+#define HIST_MIN_DIGITS		1
+#define HIST_MAX_DIGITS		4
+#define HIST_MAX_BITS		40	/* ~1100s in ns, longer is clamped */
+
+/*
+ * Log-linear (HDR like) histogram of ns values. Values below 2^sub_bits
+ * are counted exactly, above it every power of 2 range is split on
+ * 2^(sub_bits - 1) buckets, so relative error is kept under 10^-digits
+ * with constant memory whatever number of values is added.
+ */
+struct hist {
+	__u64 *cnt;
+	int sub_bits;
+	int bucket_num;
+	__u64 n;
+	__u64 neg;		/* negative values, counted in first bucket */
+	__u64 ovf;		/* values out of range, counted in last one */
+	__s64 min;
+	__s64 max;
+	double sum;
+	double sum2;
+};
+
+int hist_init(struct hist *h, int digits);
+void hist_reset(struct hist *h);
+void hist_add(struct hist *h, __s64 val);
+double hist_mean(struct hist *h);
+double hist_dev(struct hist *h);
+__s64 hist_percentile(struct hist *h, double pct);
+void hist_cumulative(struct hist *h, __s64 *le, int num, __u64 *cnt);
+double hist_ks(struct hist *a, struct hist *b);
+void hist_free(struct hist *h);
+
+#endif
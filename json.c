@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include <math.h>
+#include "json.h"
+
+static void json_esc(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++) {
+		switch (*s) {
+		case '"':
+		case '\\':
+			fputc('\\', f);
+			fputc(*s, f);
+			break;
+		case '\n':
+			fputs("\\n", f);
+			break;
+		case '\t':
+			fputs("\\t", f);
+			break;
+		default:
+			if ((unsigned char)*s < 0x20)
+				fprintf(f, "\\u%04x", *s);
+			else
+				fputc(*s, f);
+		}
+	}
+	fputc('"', f);
+}
+
+/* separator, indent and key of next member */
+static void json_key(struct json *j, const char *key)
+{
+	if (j->cnt[j->depth]++)
+		fputc(',', j->f);
+
+	fprintf(j->f, "\n%*s", 2 * (j->depth + 1), "");
+	if (key) {
+		json_esc(j->f, key);
+		fputs(": ", j->f);
+	}
+}
+
+static void json_open(struct json *j, const char *key, char beg, char end)
+{
+	json_key(j, key);
+	fputc(beg, j->f);
+
+	j->end[++j->depth] = end;
+	j->cnt[j->depth] = 0;
+}
+
+void json_begin(struct json *j, FILE *f)
+{
+	j->f = f;
+	j->depth = 0;
+	j->cnt[0] = 0;
+	j->end[0] = '}';
+	fputc('{', f);
+}
+
+void json_finish(struct json *j)
+{
+	while (j->depth)
+		json_end(j);
+
+	fputs("\n}\n", j->f);
+}
+
+void json_obj(struct json *j, const char *key)
+{
+	json_open(j, key, '{', '}');
+}
+
+void json_arr(struct json *j, const char *key)
+{
+	json_open(j, key, '[', ']');
+}
+
+void json_end(struct json *j)
+{
+	int empty = !j->cnt[j->depth];
+	char end = j->end[j->depth--];
+
+	if (!empty)
+		fprintf(j->f, "\n%*s", 2 * (j->depth + 1), "");
+
+	fputc(end, j->f);
+}
+
+void json_str(struct json *j, const char *key, const char *val)
+{
+	json_key(j, key);
+	json_esc(j->f, val);
+}
+
+void json_int(struct json *j, const char *key, long long val)
+{
+	json_key(j, key);
+	fprintf(j->f, "%lld", val);
+}
+
+void json_uint(struct json *j, const char *key, unsigned long long val)
+{
+	json_key(j, key);
+	fprintf(j->f, "%llu", val);
+}
+
+void json_dbl(struct json *j, const char *key, double val)
+{
+	json_key(j, key);
+	if (isfinite(val))
+		fprintf(j->f, "%.10g", val);
+	else
+		fputs("null", j->f);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef PLGET_JSON_H
+#define PLGET_JSON_H
+
+#include <stdio.h>
+
+#define JSON_DEPTH_MAX		8	/* nesting, not checked */
+
+/*
+ * Minimal streaming JSON writer, values are written as they come, key is
+ * NULL for array elements. Non finite doubles are written as null.
+ */
+struct json {
+	FILE *f;
+	int depth;
+	int cnt[JSON_DEPTH_MAX];	/* members written at the level */
+	char end[JSON_DEPTH_MAX];	/* closing bracket of the level */
+};
+
+void json_begin(struct json *j, FILE *f);
+void json_finish(struct json *j);
+void json_obj(struct json *j, const char *key);
+void json_arr(struct json *j, const char *key);
+void json_end(struct json *j);
+void json_str(struct json *j, const char *key, const char *val);
+void json_int(struct json *j, const char *key, long long val);
+void json_uint(struct json *j, const char *key, unsigned long long val);
+void json_dbl(struct json *j, const char *key, double val);
+
+#endif
@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "plget.h"
+#include "result.h"
+#include "trace.h"
+#include "seq.h"
+#include "metrics.h"
+
+#define METRICS_LE_NUM		19
+
+static int metrics_fd = -1;
+
+/* latency histogram buckets, 1-2-5 from 1us to 1s, in ns */
+static __s64 metrics_le[METRICS_LE_NUM] = {
+	1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000,
+	1000000, 2000000, 5000000, 10000000, 20000000, 50000000,
+	100000000, 200000000, 500000000, 1000000000,
+};
+
+static char *metrics_mod_name[] = {
+	[RX_LAT] = "rx-lat",
+	[TX_LAT] = "tx-lat",
+	[RTT_MOD] = "rtt",
+	[ECHO_LAT] = "echo-lat",
+	[PKT_GEN] = "pkt-gen",
+	[RX_RATE] = "rx-rate",
+};
+
+/* @addr - UNIX socket path if starts with '/', [IP:]PORT otherwise */
+int metrics_open(char *addr)
+{
+	struct sockaddr_in in = { .sin_family = AF_INET };
+	struct sockaddr_un un = { .sun_family = AF_UNIX };
+	struct sockaddr *sa;
+	char *port;
+	socklen_t len;
+	int one = 1;
+
+	if (addr[0] == '/') {
+		if (strlen(addr) >= sizeof(un.sun_path))
+			return fprintf(stderr, "metrics path is too long\n"), -1;
+
+		strcpy(un.sun_path, addr);
+		unlink(addr);
+		sa = (struct sockaddr *)&un;
+		len = sizeof(un);
+	} else {
+		port = strrchr(addr, ':');
+		in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (port) {
+			*port = 0;
+			if (!inet_aton(addr, &in.sin_addr))
+				return fprintf(stderr, "bad metrics ip\n"), -1;
+			*port++ = ':';
+		} else {
+			port = addr;
+		}
+
+		in.sin_port = htons(atoi(port));
+		sa = (struct sockaddr *)&in;
+		len = sizeof(in);
+	}
+
+	metrics_fd = socket(sa->sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (metrics_fd < 0)
+		return perror("metrics socket"), -errno;
+
+	setsockopt(metrics_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	if (bind(metrics_fd, sa, len) || listen(metrics_fd, 4)) {
+		perror("metrics bind");
+		close(metrics_fd);
+		metrics_fd = -1;
+		return -errno;
+	}
+
+	return 0;
+}
+
+void metrics_family(FILE *f, const char *name, const char *type,
+		    const char *help)
+{
+	fprintf(f, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+static void metrics_counter(FILE *f, const char *name, const char *help,
+			    unsigned long long val)
+{
+	metrics_family(f, name, "counter", help);
+	fprintf(f, "%s_total %llu\n", name, val);
+}
+
+static __u64 metrics_load(__u64 *v)
+{
+	return __atomic_load_n(v, __ATOMIC_RELAXED);
+}
+
+static void metrics_lat_bucket(struct stats_link *l, void *arg)
+{
+	__u64 cnt[METRICS_LE_NUM];
+	struct stats_acc acc;
+	FILE *f = arg;
+	int i;
+
+	if (!l->name)
+		return;
+
+	stats_link_snap(l, &acc);
+
+	/* raw ts backend keeps no histogram, +Inf bucket only */
+	if (l->hist) {
+		hist_cumulative(l->hist, metrics_le, METRICS_LE_NUM, cnt);
+		for (i = 0; i < METRICS_LE_NUM; i++)
+			fprintf(f, "plget_latency_seconds_bucket{link=\"%s\","
+				"le=\"%g\"} %llu\n", l->name,
+				metrics_le[i] / 1e9,
+				cnt[i] < acc.n ? cnt[i] : acc.n);
+	}
+
+	fprintf(f, "plget_latency_seconds_bucket{link=\"%s\",le=\"+Inf\"} "
+		"%llu\n", l->name, acc.n);
+	fprintf(f, "plget_latency_seconds_count{link=\"%s\"} %llu\n", l->name,
+		acc.n);
+
+	/* sum is not allowed with negative observations */
+	if (acc.n && acc.min >= 0)
+		fprintf(f, "plget_latency_seconds_sum{link=\"%s\"} %.9f\n",
+			l->name, acc.mean * acc.n / 1e9);
+}
+
+static void metrics_lat_gauge(struct stats_link *l, FILE *f, int max)
+{
+	struct stats_acc acc;
+
+	if (!l->name)
+		return;
+
+	stats_link_snap(l, &acc);
+	if (!acc.n)
+		return;
+
+	fprintf(f, "plget_latency_%s_seconds{link=\"%s\"} %.9f\n",
+		max ? "max" : "min", l->name, (max ? acc.max : acc.min) / 1e9);
+}
+
+static void metrics_lat_min(struct stats_link *l, void *arg)
+{
+	metrics_lat_gauge(l, arg, 0);
+}
+
+static void metrics_lat_max(struct stats_link *l, void *arg)
+{
+	metrics_lat_gauge(l, arg, 1);
+}
+
+static void metrics_write(FILE *f)
+{
+	struct trace_src srcs[TRACE_COL_MAX];
+	int mod = plget->mod;
+	int i, num;
+
+	metrics_family(f, "plget", "info", "measurement run");
+	fprintf(f, "plget_info{mode=\"%s\",if=\"%s\"} 1\n",
+		metrics_mod_name[mod], plget->if_name);
+
+	num = trace_collect(srcs);
+	if (num) {
+		metrics_family(f, "plget_ts", "counter", "ts taken, by stage");
+		for (i = 0; i < num; i++)
+			fprintf(f, "plget_ts_total{ts=\"%s\"} %llu\n",
+				srcs[i].name, metrics_load(&srcs[i].ss->cnt));
+
+		metrics_family(f, "plget_ts_rejected", "counter",
+			       "ts rejected, bad or duplicate id");
+		for (i = 0; i < num; i++)
+			fprintf(f, "plget_ts_rejected_total{ts=\"%s\"} %llu\n",
+				srcs[i].name, metrics_load(&srcs[i].ss->rej));
+	}
+
+	metrics_counter(f, "plget_ts_failures",
+			"packets received w/o SCM_TIMESTAMPING",
+			metrics_load(&plget->ts_fail));
+
+	metrics_family(f, "plget_latency_seconds", "histogram",
+		       "latency between ts stages");
+	res_for_each_link(metrics_lat_bucket, f);
+
+	metrics_family(f, "plget_latency_min_seconds", "gauge",
+		       "min latency between ts stages");
+	res_for_each_link(metrics_lat_min, f);
+
+	metrics_family(f, "plget_latency_max_seconds", "gauge",
+		       "max latency between ts stages");
+	res_for_each_link(metrics_lat_max, f);
+
+	if (mod == TX_LAT || mod == PKT_GEN) {
+		metrics_counter(f, "plget_send_slots_missed",
+				"timer slots w/o packet sent",
+				metrics_load(&plget->slots_missed));
+		metrics_counter(f, "plget_sends_late",
+				"packets sent a period or more late",
+				metrics_load(&plget->sends_late));
+	}
+
+	if (plget->txtime_lead) {
+		metrics_counter(f, "plget_txtime_missed",
+				"packets dropped, launch time passed",
+				metrics_load(&plget->txtime_missed));
+		metrics_counter(f, "plget_txtime_invalid",
+				"packets dropped, launch time rejected",
+				metrics_load(&plget->txtime_invalid));
+	}
+
+	if (mod == RX_RATE) {
+		metrics_counter(f, "plget_rx_packets", "packets received",
+				metrics_load(&plget->rx_pkts));
+		metrics_counter(f, "plget_rx_bytes", "frame bytes received",
+				metrics_load(&plget->rx_bytes));
+	}
+
+	if (mod == RX_LAT || mod == ECHO_LAT || mod == RTT_MOD ||
+	    mod == RX_RATE)
+		seq_metrics(f);
+
+	fprintf(f, "# EOF\n");
+}
+
+static void metrics_serve(int fd)
+{
+	struct timeval tv = { .tv_sec = METRICS_RCV_TIMEOUT };
+	char req[METRICS_REQ_MAX + 1];
+	size_t len = 0, blen;
+	char hdr[256];
+	char *body;
+	int n, hlen;
+	FILE *f;
+
+	/* whatever is asked, metrics are returned */
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	while (len < METRICS_REQ_MAX) {
+		n = recv(fd, req + len, METRICS_REQ_MAX - len, 0);
+		if (n <= 0)
+			return;
+
+		len += n;
+		req[len] = 0;
+		if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n"))
+			break;
+	}
+
+	f = open_memstream(&body, &blen);
+	if (!f)
+		return;
+
+	metrics_write(f);
+	fclose(f);
+
+	hlen = snprintf(hdr, sizeof(hdr), "HTTP/1.0 200 OK\r\n"
+			"Content-Type: application/openmetrics-text; "
+			"version=1.0.0; charset=utf-8\r\n"
+			"Content-Length: %zu\r\nConnection: close\r\n\r\n",
+			blen);
+
+	if (send(fd, hdr, hlen, MSG_NOSIGNAL) == hlen)
+		send(fd, body, blen, MSG_NOSIGNAL);
+
+	free(body);
+}
+
+/* serve scrapes one by one, till canceled */
+void *metrics_server(void *arg)
+{
+	int fd;
+
+	for (;;) {
+		fd = accept(metrics_fd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			perror("metrics accept");
+			break;
+		}
+
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		metrics_serve(fd);
+		close(fd);
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+	}
+
+	return NULL;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef PLGET_METRICS_H
+#define PLGET_METRICS_H
+
+#include <stdio.h>
+
+#define METRICS_REQ_MAX		4096	/* request is read and dropped */
+#define METRICS_RCV_TIMEOUT	1	/* s, to read request */
+
+/*
+ * OpenMetrics text exporter, served over HTTP on local TCP port or UNIX
+ * socket. Counters and histograms are read while measuring w/o locking,
+ * so measurement thread is never blocked by scrapes.
+ */
+int metrics_open(char *addr);
+void *metrics_server(void *arg);
+void metrics_family(FILE *f, const char *name, const char *type,
+		    const char *help);
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include <time.h>
+#include <errno.h>
+#include "plget.h"
+#include "hist.h"
+#include "pacer.h"
+
+static struct hist pace_err;	/* wake up or spin end - slot, ns */
+static __u64 pace_late;		/* timer woke up after slot */
+static __u64 pace_spins;	/* slots spun to */
+static __s64 pace_period;
+
+int pacer_init(void)
+{
+	pace_period = plget->interval.tv_sec * NSEC_PER_SEC +
+		      plget->interval.tv_nsec;
+
+	if (pace_err.cnt)
+		return 0;
+
+	if (hist_init(&pace_err, PACER_DIGITS))
+		return printf("Couldn't allocate pacing error hist\n"), -ENOMEM;
+
+	return 0;
+}
+
+static inline __s64 pacer_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/* pacer_wait - called once timer expired for slot, spins to it if guard */
+void pacer_wait(__u64 slot)
+{
+	__s64 dl = plget->mono0 + slot * pace_period;
+	__s64 now = pacer_now();
+
+	if (now >= dl) {
+		pace_late += !!plget->pace_guard;
+	} else if (plget->pace_guard) {
+		pace_spins++;
+		while (now < dl)
+			now = pacer_now();
+	}
+
+	if (pace_err.cnt)
+		hist_add(&pace_err, now - dl);
+}
+
+void pacer_print(FILE *f)
+{
+	struct hist *h = &pace_err;
+
+	if (!h->n)
+		return;
+
+	fprintf(f, "pacing error, ns (%s -> send slot): min %lld, "
+		"mean %.0f, p50 %lld, p99 %lld, p99.9 %lld, max %lld\n",
+		plget->pace_guard ? "spin end" : "timer wake up", h->min,
+		hist_mean(h), hist_percentile(h, 50), hist_percentile(h, 99),
+		hist_percentile(h, 99.9), h->max);
+
+	if (plget->pace_guard)
+		fprintf(f, "spin guard: %lldns, spun to %llu slots, timer "
+			"woke up after slot %llu times\n", plget->pace_guard,
+			pace_spins, pace_late);
+}
+
+void pacer_json(struct json *j)
+{
+	struct hist *h = &pace_err;
+
+	if (!h->n)
+		return;
+
+	json_obj(j, "pacing");
+	json_int(j, "guard_ns", plget->pace_guard);
+	json_uint(j, "n", h->n);
+	json_int(j, "min_ns", h->min);
+	json_dbl(j, "mean_ns", hist_mean(h));
+	json_int(j, "p50_ns", hist_percentile(h, 50));
+	json_int(j, "p99_ns", hist_percentile(h, 99));
+	json_int(j, "p99.9_ns", hist_percentile(h, 99.9));
+	json_int(j, "max_ns", h->max);
+	json_uint(j, "spins", pace_spins);
+	json_uint(j, "timer_late", pace_late);
+	json_end(j);
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef PLGET_PACER_H
+#define PLGET_PACER_H
+
+#include <stdio.h>
+#include <linux/types.h>
+#include "json.h"
+
+#define PACER_DIGITS		3
+
+/*
+ * Send slot pacing. Timer wakes up guard ns before each slot (plget->
+ * pace_guard) and the rest is spun on CLOCK_MONOTONIC, so timer wake up
+ * jitter doesn't get to the wire. Error of every wake up against its slot
+ * is kept, with or w/o spin.
+ */
+int pacer_init(void);
+void pacer_wait(__u64 slot);
+void pacer_print(FILE *f);
+void pacer_json(struct json *j);
+
+#endif
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include "plget.h"
+#include "phc.h"
+
+#define PHC_SAMPLES		(1 << 16)
+#define PHC_PERIOD		10000000	/* first sample period, ns */
+#define PHC_READS		5		/* sys clock reads per sample */
+
+/*
+ * PHC - CLOCK_REALTIME offset sampled while measuring. Once buffer is full
+ * every other sample is dropped and period is doubled, so memory is fixed
+ * and whole run is covered whatever it takes.
+ */
+static int phc_fd = -1;
+static __s64 *phc_off;
+static int phc_num;
+static __s64 phc_tau;		/* sample period, ns */
+static __s64 phc_delay;		/* best sys clock read window */
+
+static inline __s64 phc_ns(struct timespec *ts)
+{
+	return (__s64)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+int phc_open(int phc_idx)
+{
+	char phc_addr[20];
+
+	if (phc_idx < 0) {
+		printf("no PHC for the interface, clock sampling is off\n");
+		return -ENODEV;
+	}
+
+	snprintf(phc_addr, sizeof(phc_addr), "/dev/ptp%u", phc_idx);
+	phc_fd = open(phc_addr, O_RDONLY);
+	if (phc_fd < 0)
+		return perror("open PHC"), -errno;
+
+	phc_off = malloc(PHC_SAMPLES * sizeof(*phc_off));
+	if (!phc_off) {
+		close(phc_fd);
+		phc_fd = -1;
+		return -ENOMEM;
+	}
+
+	phc_tau = PHC_PERIOD;
+	return 0;
+}
+
+/* PHC read surrounded by sys clock reads, one with shortest window wins */
+static int phc_sample(__s64 *off)
+{
+	struct timespec t1, t2, p;
+	__s64 d, best = 0;
+	int i;
+
+	for (i = 0; i < PHC_READS; i++) {
+		clock_gettime(CLOCK_REALTIME, &t1);
+		if (clock_gettime(PHC_CLOCKID(phc_fd), &p))
+			return -1;
+		clock_gettime(CLOCK_REALTIME, &t2);
+
+		d = phc_ns(&t2) - phc_ns(&t1);
+		if (i && d >= best)
+			continue;
+
+		best = d;
+		*off = phc_ns(&p) - (phc_ns(&t1) + d / 2);
+	}
+
+	if (!phc_delay || best < phc_delay)
+		phc_delay = best;
+
+	return 0;
+}
+
+/* sample offset each period, till canceled */
+void *phc_sampler(void *arg)
+{
+	struct timespec next;
+	__s64 ns;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	for (;;) {
+		if (phc_sample(&phc_off[phc_num]))
+			break;
+
+		ns = phc_ns(&next);
+		if (++phc_num == PHC_SAMPLES) {
+			for (i = 0; i < PHC_SAMPLES / 2; i++)
+				phc_off[i] = phc_off[2 * i];
+
+			/* last sample is dropped, next one follows kept one */
+			phc_num = PHC_SAMPLES / 2;
+			ns -= phc_tau;
+			phc_tau *= 2;
+		}
+
+		ns += phc_tau;
+		next.tv_sec = ns / NSEC_PER_SEC;
+		next.tv_nsec = ns % NSEC_PER_SEC;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+
+	perror("PHC read");
+	return NULL;
+}
+
+/*
+ * Overlapping Allan deviation and time deviation (TDEV) from phase data x,
+ * averaging factor m, tau = m * tau0:
+ * AVAR = sum((x[i+2m] - 2x[i+m] + x[i])^2) / (2 tau^2 (N - 2m))
+ * TVAR = sum_j(sum_{i=j}^{j+m-1}(x[i+2m] - 2x[i+m] + x[i]))^2 /
+ *	  (6 m^2 (N - 3m + 1))
+ */
+static void phc_dev(double *x, int n, int m, double *adev, double *tdev)
+{
+	double d, s = 0, sum = 0, tau = (double)m * phc_tau;
+	int i;
+
+	for (i = 0; i < n - 2 * m; i++) {
+		d = x[i + 2 * m] - 2 * x[i + m] + x[i];
+		sum += d * d;
+	}
+
+	*adev = sqrt(sum / (2 * tau * tau * (n - 2 * m)));
+
+	/* inner sums of TVAR by sliding window */
+	for (i = 0; i < m; i++)
+		s += x[i + 2 * m] - 2 * x[i + m] + x[i];
+
+	sum = s * s;
+	for (i = 0; i < n - 3 * m; i++) {
+		s += x[i + 3 * m] - 2 * x[i + 2 * m] + x[i + m];
+		s -= x[i + 2 * m] - 2 * x[i + m] + x[i];
+		sum += s * s;
+	}
+
+	*tdev = sqrt(sum / (6.0 * m * m * (n - 3 * m + 1)));
+}
+
+/* offset, frequency drift, ADEV and TDEV for tau of power of 2 periods */
+void phc_print(void)
+{
+	double mean = 0, dev = 0, t, st = 0, stt = 0;
+	double slope, adev, tdev, *x;
+	int i, m, n = phc_num;
+	__s64 x0, min, max;
+
+	if (n < 2)
+		return;
+
+	x = malloc(n * sizeof(*x));
+	if (!x)
+		return;
+
+	/* offsets can be huge if not aligned, double is relative to first */
+	x0 = phc_off[0];
+	min = max = x0;
+	for (i = 0; i < n; i++) {
+		if (phc_off[i] < min)
+			min = phc_off[i];
+		if (phc_off[i] > max)
+			max = phc_off[i];
+
+		x[i] = phc_off[i] - x0;
+		mean += x[i];
+	}
+
+	mean /= n;
+	for (i = 0; i < n; i++) {
+		dev += (x[i] - mean) * (x[i] - mean);
+
+		/* least squares slope over sample index */
+		t = i - (n - 1) / 2.0;
+		st += t * (x[i] - mean);
+		stt += t * t;
+	}
+
+	slope = st / stt / phc_tau;
+
+	printf("\nPHC - CLOCK_REALTIME over %d samples each %.3fms, read "
+	       "window %lldns:\n", n, phc_tau / 1000000.0, phc_delay);
+	printf("offset mean = %lldns, min = %lldns, max = %lldns, RMS = "
+	       "%.1fns\n", x0 + (__s64)mean, min, max, sqrt(dev / n));
+	printf("frequency drift = %.3fppb\n", slope * NSEC_PER_SEC);
+	printf("%12s %14s %12s\n", "tau, s", "ADEV", "TDEV, ns");
+
+	for (m = 1; 3 * m < n; m *= 2) {
+		phc_dev(x, n, m, &adev, &tdev);
+		printf("%12.3f %14.3e %12.2f\n", (double)m * phc_tau /
+		       NSEC_PER_SEC, adev, tdev);
+	}
+
+	free(x);
+}
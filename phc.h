@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef PLGET_PHC_H
+#define PLGET_PHC_H
+
+#include <time.h>
+
+/* dynamic posix clock of opened /dev/ptpN */
+#define PHC_CLOCKID(fd)		((~(clockid_t)(fd) << 3) | 3)
+
+int phc_open(int phc_idx);
+void *phc_sampler(void *arg);
+void phc_print(void);
+
+#endif
@@ -12,15 +12,42 @@
  * GNU General Public License for more details.
  */
 
+#define _GNU_SOURCE	/* sendmmsg, cpu affinity */
 #include <poll.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/socket.h>
 #include "pkt_gen.h"
+#include "pkt_ring.h"
+#include "pacer.h"
+#include "burst.h"
 #include <unistd.h>
 #include <errno.h>
 
 #define MAX_LATENCY			5000
+#define PKT_GEN_STREAMS			(1 << (16 - STREAM_ID_SHIFT))
 
-static int fast_pktgen(void)
+/* sender of unpaced pkt-gen, main thread or one of --threads */
+struct pktgen_thd {
+	pthread_t thd;
+	int idx;
+	int cpu;
+	int sfd;
+	int sid;		/* PTP stream id, shifted */
+	unsigned long num;	/* packets to send */
+	unsigned long *cnt;	/* sent, &sent or &plget->icnt */
+	unsigned long sent;
+	__u64 calls;
+	__s64 time;
+	int ret;
+};
+
+static struct pktgen_thd *pg_thd;
+static int pg_num;
+
+static int single_pktgen(void)
 {
 	struct sockaddr *addr = (struct sockaddr *)&plget->sk_addr;
 	int dsize = plget->sk_payload_size;
@@ -29,14 +56,15 @@ static int fast_pktgen(void)
 	int sfd = plget->sfd;
 	int ret;
 
-	plget->inum = plget->pkt_num ? plget->pkt_num : ~0;
-	for (plget->icnt = 0; plget->icnt < plget->inum; plget->icnt++) {
+	for (plget->icnt = 0; plget->icnt < plget->inum && !plget->stop;
+	     plget->icnt++) {
 		if (plget->flags & PLF_PTP)
 			sid_wr(htons((plget->icnt & SEQ_ID_MASK) | sid));
 
 		tid_wr(plget->icnt);
 		ret = sendto(sfd, packet, dsize, 0, addr,
 			     sizeof(plget->sk_addr));
+		plget->send_calls++;
 		if (ret != dsize) {
 			if (ret < 0)
 				perror("sendto");
@@ -47,32 +75,342 @@ static int fast_pktgen(void)
 		}
 	}
 
+	return 0;
+}
+
+/*
+ * Ring of batch packet copies, ids of each are rewritten every round and
+ * whole ring is submitted with one sendmmsg. Packets not taken by the
+ * socket are sent in the next round with same ids.
+ */
+static int batch_pktgen(struct pktgen_thd *t)
+{
+	int dsize = plget->sk_payload_size;
+	int batch = plget->batch;
+	struct mmsghdr *msg;
+	struct iovec *iov;
+	unsigned long num;
+	char *ring, *pkt;
+	int i, ret = 0;
+
+	ring = malloc(batch * dsize);
+	msg = calloc(batch, sizeof(*msg));
+	iov = calloc(batch, sizeof(*iov));
+	if (!ring || !msg || !iov) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < batch; i++) {
+		memcpy(ring + i * dsize, plget->pkt, dsize);
+		iov[i].iov_base = ring + i * dsize;
+		iov[i].iov_len = dsize;
+		msg[i].msg_hdr.msg_name = &plget->sk_addr;
+		msg[i].msg_hdr.msg_namelen = sizeof(plget->sk_addr);
+		msg[i].msg_hdr.msg_iov = &iov[i];
+		msg[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for (*t->cnt = 0; *t->cnt < t->num && !plget->stop;) {
+		num = t->num - *t->cnt;
+		if (num > batch)
+			num = batch;
+
+		for (i = 0, pkt = ring; i < num; i++, pkt += dsize) {
+			if (plget->flags & PLF_PTP)
+				pkt_sid_wr(pkt, htons(((*t->cnt + i) &
+						       SEQ_ID_MASK) | t->sid));
+			pkt_tid_wr(pkt, *t->cnt + i);
+		}
+
+		ret = sendmmsg(t->sfd, msg, num, 0);
+		t->calls++;
+		if (ret < 0) {
+			perror("sendmmsg");
+			break;
+		}
+
+		for (i = 0; i < ret; i++) {
+			if (msg[i].msg_len != dsize)
+				break;
+		}
+
+		*t->cnt += i;
+		if (i < ret) {
+			printf("cannot send whole packet\n");
+			break;
+		}
+	}
+
+	ret = 0;
+out:
+	free(iov);
+	free(msg);
+	free(ring);
+	return ret;
+}
+
+static void *pktgen_worker(void *arg)
+{
+	struct pktgen_thd *t = arg;
+	struct timespec t1, t2;
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(t->cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+		printf("thread %d: cannot be pinned to cpu %d\n", t->idx,
+		       t->cpu);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	t->ret = batch_pktgen(t);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	t->time = (t2.tv_sec - t1.tv_sec) * NSEC_PER_SEC +
+		  t2.tv_nsec - t1.tv_nsec;
+	return NULL;
+}
+
+/* n-th cpu the process may run on, round robin */
+static int pktgen_cpu(cpu_set_t *set, int n)
+{
+	int cpu, num = CPU_COUNT(set);
+
+	n %= num;
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, set) && !n--)
+			break;
+	}
+
+	return cpu;
+}
+
+/*
+ * Every thread sends its share of packets from own socket, pinned to own
+ * cpu, so XPS or priority to queue mapping spreads them over tx queues.
+ * Each thread has own tid space and PTP stream id.
+ */
+static int threads_pktgen(void)
+{
+	int num = plget->threads;
+	struct pktgen_thd *t;
+	cpu_set_t set;
+	int i, ret = 0;
+
+	pg_thd = calloc(num, sizeof(*pg_thd));
+	if (!pg_thd)
+		return -ENOMEM;
+
+	plget->icnt = 0;
+
+	if (sched_getaffinity(0, sizeof(set), &set))
+		return perror("sched_getaffinity"), -errno;
+
+	for (i = 0; i < num; i++) {
+		t = &pg_thd[i];
+		t->idx = i;
+		t->cpu = pktgen_cpu(&set, i);
+		t->cnt = &t->sent;
+		t->sid = ((plget->stream_id >> STREAM_ID_SHIFT) + i) %
+			 PKT_GEN_STREAMS << STREAM_ID_SHIFT;
+
+		/* continuous if no packet num */
+		if (plget->pkt_num)
+			t->num = plget->pkt_num / num +
+				 (i < plget->pkt_num % num);
+		else
+			t->num = ~0;
+
+		t->sfd = i ? plget_tx_socket(plget->flags & PLF_PRIO ?
+					     plget->prio + i : -1) :
+			     plget->sfd;
+		if (t->sfd < 0) {
+			ret = t->sfd;
+			break;
+		}
+	}
+
+	for (i = 0; !ret && i < num; i++) {
+		ret = -pthread_create(&pg_thd[i].thd, NULL, pktgen_worker,
+				      &pg_thd[i]);
+		if (ret)
+			printf("cannot start pkt-gen thread %d\n", i);
+	}
+
+	pg_num = i;
+	for (i = 0; i < pg_num; i++) {
+		t = &pg_thd[i];
+		pthread_join(t->thd, NULL);
+
+		plget->icnt += t->sent;
+		plget->send_calls += t->calls;
+		if (t->time > plget->send_time)
+			plget->send_time = t->time;
+		if (t->ret && !ret)
+			ret = t->ret;
+	}
+
+	for (i = 1; i < num; i++) {
+		if (pg_thd[i].sfd > 0)
+			close(pg_thd[i].sfd);
+	}
+
+	return ret;
+}
+
+void pktgen_print(FILE *f)
+{
+	struct pktgen_thd *t;
+	int i;
+
+	for (i = 0; i < pg_num; i++) {
+		t = &pg_thd[i];
+		fprintf(f, "thread %d: cpu %d, stream %d, packets %lu, "
+			"send calls %llu, %.0f pps\n", t->idx, t->cpu,
+			t->sid >> STREAM_ID_SHIFT, t->sent, t->calls,
+			t->time > 0 ? t->sent * (double)NSEC_PER_SEC / t->time :
+			0);
+	}
+}
+
+void pktgen_json(struct json *j)
+{
+	struct pktgen_thd *t;
+	int i;
+
+	if (!pg_num)
+		return;
+
+	json_arr(j, "threads");
+	for (i = 0; i < pg_num; i++) {
+		t = &pg_thd[i];
+		json_obj(j, NULL);
+		json_int(j, "cpu", t->cpu);
+		json_int(j, "stream", t->sid >> STREAM_ID_SHIFT);
+		json_uint(j, "packets", t->sent);
+		json_uint(j, "calls", t->calls);
+		json_dbl(j, "pps", t->time > 0 ?
+			 t->sent * (double)NSEC_PER_SEC / t->time : 0);
+		json_end(j);
+	}
+	json_end(j);
+}
+
+/*
+ * Frames are built in the TX ring already, ids are written in place and
+ * kernel is kicked once per batch.
+ */
+static int ring_pktgen(void)
+{
+	int sid = plget->stream_id;
+	int ret = 0;
+
+	for (plget->icnt = 0; plget->icnt < plget->inum && !plget->stop;
+	     plget->icnt++) {
+		if (plget->flags & PLF_PTP)
+			sid_wr(htons((plget->icnt & SEQ_ID_MASK) | sid));
+
+		tid_wr(plget->icnt);
+		ret = pkt_ring_queue();
+		if (ret)
+			break;
+
+		if (!((plget->icnt + 1) % plget->batch)) {
+			ret = pkt_ring_flush();
+			if (ret)
+				break;
+		}
+	}
+
+	if (!ret)
+		ret = pkt_ring_flush();
+
+	return ret;
+}
+
+/* as fast as socket takes, send calls and time are counted for pps */
+static int fast_pktgen(void)
+{
+	struct timespec t1, t2;
+	struct pktgen_thd t;
+	int ret;
+
+	plget->inum = plget->pkt_num ? plget->pkt_num : ~0;
+
+	if (plget->threads > 1) {
+		ret = threads_pktgen();
+		if (ret)
+			return ret;
+
+		plget->pkt_num = plget->icnt;
+		return !(plget->icnt == plget->inum || plget->stop);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (plget->flags & PLF_TX_RING) {
+		ret = ring_pktgen();
+	} else if (plget->batch > 1) {
+		t.sfd = plget->sfd;
+		t.sid = plget->stream_id;
+		t.num = plget->inum;
+		t.cnt = &plget->icnt;
+		t.calls = 0;
+		ret = batch_pktgen(&t);
+		plget->send_calls = t.calls;
+	} else {
+		ret = single_pktgen();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	plget->send_time = (t2.tv_sec - t1.tv_sec) * NSEC_PER_SEC +
+			   t2.tv_nsec - t1.tv_nsec;
+	if (ret)
+		return ret;
+
 	plget->pkt_num = plget->icnt;
-	return !(plget->icnt == plget->inum);
+	return !(plget->icnt == plget->inum || plget->stop);
+}
+
+static int pktgen_sendto(void)
+{
+	if (plget->flags & PLF_TX_RING)
+		return pkt_ring_send();
+
+	return sendto(plget->sfd, plget->pkt, plget->sk_payload_size, 0,
+		      (struct sockaddr *)&plget->sk_addr,
+		      sizeof(plget->sk_addr));
 }
 
 int pktgen_proc(void)
 {
-	struct sockaddr *addr = (struct sockaddr *)&plget->sk_addr;
 	int dsize = plget->sk_payload_size;
 	int sid = plget->stream_id;
-	char *packet = plget->pkt;
-	int sfd = plget->sfd;
 	struct pollfd fds[1];
-	uint64_t exps;
-	int ret;
+	uint64_t exps, slot = 0;
+	__s64 period, plan, lag;
+	struct timespec ts;
+	int num, ret;
+
+	if (plget->burst > 1) {
+		ret = burst_init();
+		if (ret)
+			return ret;
+	}
 
 	ret = plget_start_timer();
 	if (ret)
 		return ret;
 
+	period = plget->interval.tv_sec * NSEC_PER_SEC +
+		 plget->interval.tv_nsec;
+
 	fds[0].fd = plget->timer_fd;
 	fds[0].events = POLLIN;
 
 	plget->inum = plget->pkt_num ? plget->pkt_num : ~0;
 	tid_wr(0);
 
-	for (plget->icnt = 0; plget->icnt < plget->inum;) {
+	for (plget->icnt = 0; plget->icnt < plget->inum && !plget->stop;) {
 		ret = poll(fds, 1, MAX_LATENCY);
 		if (ret <= 0) {
 			if (!ret) {
@@ -80,7 +418,8 @@ int pktgen_proc(void)
 				break;
 			}
 
-			perror("Some error on poll()");
+			if (errno != EINTR)
+				perror("Some error on poll()");
 			break;
 		}
 
@@ -90,26 +429,51 @@ int pktgen_proc(void)
 			if (ret < 0)
 				return perror("Couldn't read timerfd"), -errno;
 
-			ret = sendto(sfd, packet, dsize, 0, addr,
-				     sizeof(plget->sk_addr));
-			if (ret != dsize) {
+			/* packet is for first expired slot, rest are missed */
+			pacer_wait(slot);
+			plan = plget->slot0 + slot * period;
+			plget->slots_missed += exps - 1;
+			slot += exps;
+
+			num = plget->burst;
+			if (num > plget->inum - plget->icnt)
+				num = plget->inum - plget->icnt;
+
+			clock_gettime(CLOCK_REALTIME, &ts);
+			if (num > 1) {
+				ret = burst_send(plget->icnt, num, 0);
+			} else {
+				ret = pktgen_sendto();
 				if (ret < 0)
 					perror("sendto");
 				else
-					perror("cannot send whole packet\n");
+					ret = ret == dsize;
+			}
+
+			lag = ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec - plan;
+			if (lag >= period)
+				plget->sends_late++;
+			if (lag > plget->send_lag_max)
+				plget->send_lag_max = lag;
+			if (ret > 0)
+				plget->icnt += ret;
+			if (ret != num) {
+				if (ret >= 0)
+					printf("cannot send whole packet, %d of "
+					       "%d sent\n", ret, num);
 
 				break;
 			}
 
 			if (plget->flags & PLF_PTP)
-				sid_wr(htons((++plget->icnt & SEQ_ID_MASK) |
+				sid_wr(htons((plget->icnt & SEQ_ID_MASK) |
 					      sid));
 			tid_wr(plget->icnt);
 		}
 	}
 
 	plget->pkt_num = plget->icnt;
-	return !(plget->icnt == plget->inum);
+	return !(plget->icnt == plget->inum || plget->stop);
 }
 
 int pktgen(void)
@@ -125,6 +489,7 @@ int pktgen(void)
 
 	ret = pktgen_proc();
 
+	burst_free();
 	close(plget->timer_fd);
 	return ret;
 }
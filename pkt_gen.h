@@ -15,8 +15,15 @@
 #ifndef PKT_GEN_H
 #define PKT_GEN_H
 
+#include <stdio.h>
 #include "plget.h"
+#include "json.h"
+
+#define PKT_GEN_BATCH_MAX		1024	/* UIO_MAXIOV, sendmmsg limit */
+#define PKT_GEN_THREADS_MAX		64
 
 int pktgen(void);
+void pktgen_print(FILE *f);
+void pktgen_json(struct json *j);
 
 #endif
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include "plget.h"
+#include "pkt_ring.h"
+
+/* tx frame data follows the header w/o sockaddr_ll, see tpacket_snd() */
+#define PKT_RING_DATA_OFF	(TPACKET3_HDRLEN - sizeof(struct sockaddr_ll))
+
+static char *ring;
+static int ring_head;
+static int ring_pend;		/* frames requested, not kicked yet */
+
+static inline struct tpacket3_hdr *pkt_ring_hdr(int idx)
+{
+	return (struct tpacket3_hdr *)(ring + idx * PKT_RING_FRAME_SIZE);
+}
+
+char *pkt_ring_frame(int idx)
+{
+	return (char *)pkt_ring_hdr(idx) + PKT_RING_DATA_OFF;
+}
+
+int pkt_ring_setup(int sfd)
+{
+	struct tpacket_req3 req = {0};
+	int ver = TPACKET_V3;
+	size_t size;
+
+	if (setsockopt(sfd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)))
+		return perror("PACKET_VERSION"), -errno;
+
+	size = PKT_RING_FRAME_NUM * PKT_RING_FRAME_SIZE;
+	req.tp_block_size = PKT_RING_BLOCK_SIZE;
+	req.tp_block_nr = size / PKT_RING_BLOCK_SIZE;
+	req.tp_frame_size = PKT_RING_FRAME_SIZE;
+	req.tp_frame_nr = PKT_RING_FRAME_NUM;
+
+	if (setsockopt(sfd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)))
+		return perror("PACKET_TX_RING"), -errno;
+
+	ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, sfd, 0);
+	if (ring == MAP_FAILED) {
+		ring = NULL;
+		return perror("mmap tx ring"), -errno;
+	}
+
+	ring_head = 0;
+	plget->pkt = pkt_ring_frame(0);
+	return 0;
+}
+
+/* let kernel send all requested frames, w/o waiting for completion */
+static int pkt_ring_kick(void)
+{
+	int ret;
+
+	if (!ring_pend)
+		return 0;
+
+	ret = sendto(plget->sfd, NULL, 0, MSG_DONTWAIT,
+		     (struct sockaddr *)&plget->sk_addr,
+		     sizeof(plget->sk_addr));
+	plget->send_calls++;
+	ring_pend = 0;
+
+	if (ret < 0 && errno != EAGAIN)
+		return perror("tx ring kick"), -errno;
+
+	return 0;
+}
+
+/* head frame has to be given back before next packet is written to it */
+static int pkt_ring_wait(void)
+{
+	struct tpacket3_hdr *hdr = pkt_ring_hdr(ring_head);
+	struct pollfd fds[1];
+	__u32 st;
+	int ret;
+
+	fds[0].fd = plget->sfd;
+	fds[0].events = POLLOUT;
+
+	for (;;) {
+		st = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+		if (st & TP_STATUS_WRONG_FORMAT) {
+			printf("tx ring: frame of wrong format\n");
+			return -EINVAL;
+		}
+
+		if (!(st & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING)))
+			return 0;
+
+		ret = pkt_ring_kick();
+		if (ret)
+			return ret;
+
+		ret = poll(fds, 1, PKT_RING_WAIT);
+		if (ret < 0)
+			return perror("tx ring poll"), -errno;
+
+		if (!ret) {
+			printf("tx ring: timed out waiting for frame\n");
+			return -ETIME;
+		}
+	}
+}
+
+/* request head frame to be sent */
+static void pkt_ring_put(void)
+{
+	struct tpacket3_hdr *hdr = pkt_ring_hdr(ring_head);
+
+	hdr->tp_len = plget->sk_payload_size;
+	hdr->tp_next_offset = 0;
+	__atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST,
+			 __ATOMIC_RELEASE);
+	ring_pend++;
+}
+
+static int pkt_ring_next(void)
+{
+	if (++ring_head == PKT_RING_FRAME_NUM)
+		ring_head = 0;
+
+	plget->pkt = pkt_ring_frame(ring_head);
+	return pkt_ring_wait();
+}
+
+/* request head frame to be sent with next flush, move to next one */
+int pkt_ring_queue(void)
+{
+	pkt_ring_put();
+	return pkt_ring_next();
+}
+
+int pkt_ring_flush(void)
+{
+	return pkt_ring_kick();
+}
+
+/* sendto() replacement, one packet is queued and sent right away */
+int pkt_ring_send(void)
+{
+	int ret;
+
+	pkt_ring_put();
+	ret = pkt_ring_kick();
+	if (!ret)
+		ret = pkt_ring_next();
+
+	return ret ? ret : plget->sk_payload_size;
+}
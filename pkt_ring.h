@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef PLGET_PKT_RING_H
+#define PLGET_PKT_RING_H
+
+#define PKT_RING_FRAME_SIZE	2048
+#define PKT_RING_FRAME_NUM	256
+#define PKT_RING_BLOCK_SIZE	(1 << 16)
+#define PKT_RING_WAIT		1000	/* ms for a frame to be given back */
+
+/*
+ * PACKET_MMAP TX ring (TPACKET_V3) of raw packet socket. Frames are built
+ * in the ring once, plget->pkt points to data of the head frame, so ids are
+ * written in place and the frame is handed over to the kernel w/o copy.
+ */
+int pkt_ring_setup(int sfd);
+char *pkt_ring_frame(int idx);
+int pkt_ring_queue(void);
+int pkt_ring_flush(void);
+int pkt_ring_send(void);
+
+#endif
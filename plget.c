@@ -12,7 +12,7 @@
  * GNU General Public License for more details.
  */
 
-#include <netpacket/packet.h>
+#include <linux/if_packet.h>
 #include <linux/net_tstamp.h>
 #include <net/ethernet.h>
 #include <sys/timerfd.h>
@@ -37,7 +37,17 @@
 #include "xdp_sock.h"
 #include "xdp_prog_load.h"
 #include <pthread.h>
+#include <signal.h>
 #include "rtprint.h"
+#include "store.h"
+#include "trace.h"
+#include "worst.h"
+#include "phc.h"
+#include "metrics.h"
+#include "base.h"
+#include "seq.h"
+#include "pkt_ring.h"
+#include "pacer.h"
 #include <linux/ethtool.h>
 
 #define ALIGN_ROUNDUP(x, align)\
@@ -54,6 +64,8 @@
 struct plgett *plget;
 
 struct stats tx_app_v;
+struct stats tx_plan_v;
+struct stats tx_txtime_v;
 struct stats *tx_sch_v;
 struct stats tx_sw_v;
 struct stats tx_hw_v;
@@ -61,8 +73,6 @@ struct stats rx_app_v;
 struct stats rx_sw_v;
 struct stats rx_hw_v;
 
-struct stats temp;
-
 static unsigned char ptpv2_sync_pkt[] = {
 	0x10, 0x02, 0x00, 0x2c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -84,21 +94,55 @@ int plget_create_timer(void)
 int plget_start_timer(void)
 {
 	struct itimerspec tspec = { 0 };
+	struct timespec real, tai;
+	__s64 delay = 100000;
+	__s64 period, now;
 	int ret;
 
-	tspec.it_value.tv_sec = 0;
-	tspec.it_value.tv_nsec = 100000;
+	/* absolute first expiration, so schedule is known in realtime also */
+	clock_gettime(CLOCK_MONOTONIC, &tspec.it_value);
+	clock_gettime(CLOCK_REALTIME, &real);
+
+	/* timer expires guard before each slot, rest is spun by pacer */
+	delay += plget->pace_guard;
+
+	/* launch times on whole periods of TAI, wake up is lead before */
+	if (plget->txtime_lead) {
+		clock_gettime(CLOCK_TAI, &tai);
+		now = tai.tv_sec * NSEC_PER_SEC + tai.tv_nsec;
+		period = plget->interval.tv_sec * NSEC_PER_SEC +
+			 plget->interval.tv_nsec;
+
+		plget->tai_off = now - (__s64)(real.tv_sec * NSEC_PER_SEC +
+					       real.tv_nsec);
+		plget->txtime0 = (now + delay + plget->txtime_lead) /
+				 period * period + period;
+		delay = plget->txtime0 - plget->txtime_lead - now;
+	}
+
+	plget->mono0 = tspec.it_value.tv_sec * NSEC_PER_SEC +
+		       tspec.it_value.tv_nsec + delay;
+	plget->slot0 = real.tv_sec * NSEC_PER_SEC + real.tv_nsec + delay;
+	delay -= plget->pace_guard;
+
+	tspec.it_value.tv_sec += delay / NSEC_PER_SEC;
+	tspec.it_value.tv_nsec += delay % NSEC_PER_SEC;
+	if (tspec.it_value.tv_nsec >= NSEC_PER_SEC) {
+		tspec.it_value.tv_nsec -= NSEC_PER_SEC;
+		tspec.it_value.tv_sec++;
+	}
 
 	tspec.it_interval.tv_sec = plget->interval.tv_sec;
 	tspec.it_interval.tv_nsec = plget->interval.tv_nsec;
 
-	ret = timerfd_settime(plget->timer_fd, 0, &tspec, NULL);
+	ret = timerfd_settime(plget->timer_fd, TFD_TIMER_ABSTIME, &tspec,
+			      NULL);
 	if (ret < 0) {
 		perror("Couldn't set timer");
 		return -1;
 	}
 
-	return 0;
+	return pacer_init();
 }
 
 void plget_stop_timer(void)
@@ -487,6 +531,7 @@ static int packet_socket(void)
 	struct sockaddr_ll *addr = &plget->sk_addr;
 	__u16 protocol;
 	int sfd, ret;
+	int one = 1;
 
 	specify_protocol(&protocol);
 
@@ -517,6 +562,16 @@ static int packet_socket(void)
 	if (plget_mcast(sfd))
 		return -errno;
 
+	if (plget->flags & PLF_QDISC_BYPASS) {
+		ret = setsockopt(sfd, SOL_PACKET, PACKET_QDISC_BYPASS, &one,
+				 sizeof(one));
+		if (ret < 0)
+			return perror("Couldn't bypass qdisc"), -errno;
+	}
+
+	if (plget->flags & PLF_TX_RING && pkt_ring_setup(sfd))
+		return -errno;
+
 	return sfd;
 }
 
@@ -541,9 +596,93 @@ static int plget_more_sock_options(void)
 			return perror("Couldn't set busy poll time"), -errno;
 	}
 
+	if (plget->txtime_lead) {
+		struct sock_txtime txt = {
+			.clockid = CLOCK_TAI,
+			.flags = SOF_TXTIME_REPORT_ERRORS,
+		};
+
+		ret = setsockopt(sfd, SOL_SOCKET, SO_TXTIME, &txt, sizeof(txt));
+		if (ret < 0)
+			return perror("Couldn't set SO_TXTIME"), -errno;
+	}
+
 	return 0;
 }
 
+/*
+ * one more socket sending same packets as plget->sfd, for pkt-gen threads,
+ * prio < 0 - default priority
+ */
+int plget_tx_socket(int prio)
+{
+	struct ip_mreqn mreq;
+	int sfd, ret, type;
+	int one = 1;
+
+	if (plget->pkt_type == PKT_UDP) {
+		sfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (sfd < 0)
+			return perror("socket"), -errno;
+
+		ret = setsockopt(sfd, SOL_SOCKET, SO_BINDTODEVICE,
+				 plget->if_name, sizeof(plget->if_name));
+		if (ret < 0) {
+			perror("Couldn't bind to the interface");
+			goto err;
+		}
+
+		if (plget->flags & PLF_PTP) {
+			mreq.imr_multiaddr = plget->iaddr;
+			mreq.imr_address.s_addr = htonl(INADDR_ANY);
+			mreq.imr_ifindex = plget->ifidx;
+			ret = setsockopt(sfd, IPPROTO_IP, IP_MULTICAST_IF,
+					 &mreq, sizeof(mreq));
+			if (ret < 0) {
+				perror("set multicast");
+				goto err;
+			}
+		}
+	} else {
+		type = plget->pkt_type == PKT_RAW ? SOCK_RAW : SOCK_DGRAM;
+		sfd = socket(AF_PACKET, type, plget->sk_addr.sll_protocol);
+		if (sfd < 0)
+			return perror("socket"), -errno;
+
+		ret = bind(sfd, (struct sockaddr *)&plget->sk_addr,
+			   sizeof(struct sockaddr_ll));
+		if (ret < 0) {
+			perror("Couldn't bind() to interface");
+			goto err;
+		}
+
+		if (plget->flags & PLF_QDISC_BYPASS) {
+			ret = setsockopt(sfd, SOL_PACKET, PACKET_QDISC_BYPASS,
+					 &one, sizeof(one));
+			if (ret < 0) {
+				perror("Couldn't bypass qdisc");
+				goto err;
+			}
+		}
+	}
+
+	if (prio >= 0) {
+		ret = setsockopt(sfd, SOL_SOCKET, SO_PRIORITY, &prio,
+				 sizeof(prio));
+		if (ret < 0) {
+			perror("Couldn't set priority");
+			goto err;
+		}
+	}
+
+	return sfd;
+
+err:
+	ret = -errno;
+	close(sfd);
+	return ret;
+}
+
 /* spare socket type, to get info only */
 static int plget_spare_socket(void)
 {
@@ -615,11 +754,19 @@ static void fill_in_packets(void)
 	if (plget->flags & PLF_PTP)
 		ptp_payload_size -= PTP_HSIZE;
 
-	n = (plget->pkt_type == PKT_XDP) ? FRAME_NUM : 1;
+	if (plget->pkt_type == PKT_XDP)
+		n = FRAME_NUM;
+	else if (plget->flags & PLF_TX_RING)
+		n = PKT_RING_FRAME_NUM;
+	else
+		n = 1;
+
 	for (i = 0; i < n; i++) {
 		if (plget->pkt_type == PKT_XDP) {
 			j = FRAME_SIZE * i;
 			plget->pkt = &plget->xsk->umem->frames[j];
+		} else if (plget->flags & PLF_TX_RING) {
+			plget->pkt = pkt_ring_frame(i);
 		}
 
 		if (plget->pkt_type == PKT_RAW || plget->pkt_type == PKT_XDP) {
@@ -636,12 +783,15 @@ static void fill_in_packets(void)
 
 		*dp++ = MAGIC;
 
-		for (j = 0; j < ptp_payload_size; j++)
+		/* magic is part of payload */
+		for (j = 1; j < ptp_payload_size; j++)
 			*dp++ = (rand() % 230) + 1;
 	}
 
 	if (plget->pkt_type == PKT_XDP)
 		plget->pkt = plget->xsk->umem->frames;
+	else if (plget->flags & PLF_TX_RING)
+		plget->pkt = pkt_ring_frame(0);
 }
 
 static int plget_create_packet(void)
@@ -686,7 +836,7 @@ static int plget_create_packet(void)
 
 	/* allocate packet */
 	plget->sk_payload_size = payload_size;
-	if (plget->pkt_type != PKT_XDP) {
+	if (plget->pkt_type != PKT_XDP && !(plget->flags & PLF_TX_RING)) {
 		plget->pkt = malloc(payload_size);
 		if (!plget->pkt)
 			return -ENOMEM;
@@ -737,10 +887,34 @@ static void fill_in_data_pointers(void)
 	}
 }
 
+/* raw ts vector or ts window if histogram backend is used */
+static int plget_stats_reserve(struct stats *ss, int gap)
+{
+	int digits = plget->hist_digits;
+	__s64 *ts;
+
+	if (plget->ts_file) {
+		ts = store_map(plget->pkt_num, &ss->next_ts);
+		if (!ts)
+			return -1;
+
+		stats_reserve_buf(ss, ts, plget->pkt_num);
+		return 0;
+	}
+
+	if (!digits)
+		return stats_reserve(ss, plget->pkt_num);
+
+	gap = gap && plget->flags & PLF_IPGAP_STAT;
+	return stats_reserve_hist(ss, plget->pkt_num, STATS_WIN,
+				  gap ? digits : 0);
+}
+
 static int init_test(void)
 {
 	int ts_flags = SOF_TIMESTAMPING_SOFTWARE;
 	int i, ret, mod = plget->mod;
+	int sw_gap = plget->flags & PLF_DIS_HW_TS;
 
 	ret = plget_create_socket();
 	if (ret)
@@ -756,40 +930,62 @@ static int init_test(void)
 
 	enable_hw_timestamping();
 
-	if (mod == RTT_MOD || mod == ECHO_LAT || mod == TX_LAT ||
-	    mod == RX_LAT)
-		stats_reserve(&temp, plget->pkt_num);
+	if (plget->ts_file) {
+		ret = store_open(plget->ts_file);
+		if (ret)
+			return ret;
+	}
 
 	/* reserve stats memory and set ts flags */
 	if (mod == RTT_MOD || mod == ECHO_LAT || mod == TX_LAT) {
 		if (plget->flags & PLF_PRINTOUT) {
-			stats_reserve(&tx_app_v, plget->pkt_num);
-			stats_reserve(&tx_sw_v, plget->pkt_num);
-			stats_reserve(&tx_hw_v, plget->pkt_num);
+			plget_stats_reserve(&tx_app_v, 0);
+			plget_stats_reserve(&tx_sw_v, sw_gap);
+			plget_stats_reserve(&tx_hw_v, !sw_gap);
 		}
 
+		/* only tx-lat sends on fixed schedule */
+		if (mod == TX_LAT && plget->flags & PLF_LATENCY_STAT)
+			plget_stats_reserve(&tx_plan_v, 0);
+
+		if (mod == TX_LAT && plget->flags & PLF_LATENCY_STAT &&
+		    plget->txtime_lead)
+			plget_stats_reserve(&tx_txtime_v, 0);
+
 		ts_flags |= SOF_TIMESTAMPING_TX_SOFTWARE;
 		ts_flags |= SOF_TIMESTAMPING_TX_HARDWARE;
 
 		if (plget->flags & PLF_SCHED_STAT) {
 			ts_flags |= SOF_TIMESTAMPING_TX_SCHED;
-			tx_sch_v = malloc(plget->dev_deep * sizeof(*tx_sch_v));
+			tx_sch_v = calloc(plget->dev_deep, sizeof(*tx_sch_v));
 			for (i = 0; i < plget->dev_deep; i++)
-				stats_reserve(&tx_sch_v[i], plget->pkt_num);
+				plget_stats_reserve(&tx_sch_v[i], 0);
 		}
 	}
 
 	if (mod == RTT_MOD || mod == ECHO_LAT || mod == RX_LAT ||
 	    mod == RX_RATE) {
 		if (plget->flags & PLF_PRINTOUT) {
-			stats_reserve(&rx_app_v, plget->pkt_num);
-			stats_reserve(&rx_sw_v, plget->pkt_num);
-			stats_reserve(&rx_hw_v, plget->pkt_num);
+			plget_stats_reserve(&rx_app_v, 0);
+			plget_stats_reserve(&rx_sw_v, sw_gap);
+			plget_stats_reserve(&rx_hw_v, !sw_gap);
 		}
 
 		ts_flags |= SOF_TIMESTAMPING_RX_SOFTWARE;
 	}
 
+	ret = res_stats_init();
+	if (ret)
+		return ret;
+
+	if (plget->worst_num) {
+		ret = worst_init(plget->worst_num);
+		if (ret)
+			return ret;
+	}
+
+	seq_init(mod == RX_RATE ? 0 : plget->pkt_num);
+
 	ts_flags |= SOF_TIMESTAMPING_RAW_HARDWARE;
 
 	/* create and fill in packet */
@@ -806,10 +1002,19 @@ static int init_test(void)
 	return ret;
 }
 
+/* end of continuous run, proc loops stop and results are printed as usual */
+static void plget_stop(int sig)
+{
+	plget->stop = 1;
+}
+
 int main(int argc, char **argv)
 {
-	int ret;
-	pthread_t rt_thd;
+	int ret, reg;
+	pthread_t rt_thd, sum_thd, flush_thd, rep_thd, phc_thd, met_thd;
+	int mlock_flags;
+	struct sigaction sa;
+	sigset_t set;
 
 	if (argc == 1) {
 		res_print_time();
@@ -830,12 +1035,63 @@ int main(int argc, char **argv)
 		return 0;
 
 	/* lock current and future pages */
-	if (mlockall(MCL_CURRENT | MCL_FUTURE))
+	mlock_flags = MCL_CURRENT | MCL_FUTURE;
+
+	/* ts file can be bigger than RAM, lock only faulted pages, w/o it */
+	if (plget->ts_file)
+		mlock_flags |= MCL_ONFAULT;
+
+	if (mlockall(mlock_flags))
 		perror("mlockall failed");
 
+	/* SIGUSR1 is handled by summary thread only, SIGINT/SIGTERM by main
+	 * thread only if continuous, to interrupt its waits. Blocked before
+	 * any thread is created, so every thread inherits the mask.
+	 */
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	if (plget->flags & PLF_CONTINUOUS) {
+		sigaddset(&set, SIGINT);
+		sigaddset(&set, SIGTERM);
+	}
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	if (plget->ts_file) {
+		store_unlock();
+		if (!pthread_create(&flush_thd, NULL, store_flusher, NULL))
+			pthread_detach(flush_thd);
+	}
+
+	if (!pthread_create(&sum_thd, NULL, rtsummary, NULL))
+		pthread_detach(sum_thd);
+
 	if (plget->flags & PLF_RT_PRINT)
 		ret = pthread_create(&rt_thd, NULL, rtprint, NULL);
 
+	if (ts_correct(&plget->report) &&
+	    pthread_create(&rep_thd, NULL, rtreport, NULL))
+		plget->report.tv_sec = plget->report.tv_nsec = 0;
+
+	if (plget->flags & PLF_PHC_DEV && (phc_open(plget->phc_idx) ||
+	    pthread_create(&phc_thd, NULL, phc_sampler, NULL)))
+		plget->flags &= ~PLF_PHC_DEV;
+
+	if (plget->metrics_addr && (metrics_open(plget->metrics_addr) ||
+	    pthread_create(&met_thd, NULL, metrics_server, NULL)))
+		plget->metrics_addr = NULL;
+
+	if (plget->flags & PLF_CONTINUOUS) {
+		sigemptyset(&set);
+		sigaddset(&set, SIGINT);
+		sigaddset(&set, SIGTERM);
+		sa.sa_handler = plget_stop;
+		sa.sa_flags = 0;
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGINT, &sa, NULL);
+		sigaction(SIGTERM, &sa, NULL);
+		pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+	}
+
 	switch (plget->mod) {
 	case RX_LAT:
 		ret = rxlat();
@@ -867,7 +1123,41 @@ int main(int argc, char **argv)
 		pthread_join(rt_thd, NULL);
 	}
 
+	if (ts_correct(&plget->report)) {
+		pthread_cancel(rep_thd);
+		pthread_join(rep_thd, NULL);
+	}
+
+	if (plget->flags & PLF_PHC_DEV) {
+		pthread_cancel(phc_thd);
+		pthread_join(phc_thd, NULL);
+	}
+
+	if (plget->metrics_addr) {
+		pthread_cancel(met_thd);
+		pthread_join(met_thd, NULL);
+	}
+
 	res_stats_print();
+
+	if (plget->flags & PLF_PHC_DEV)
+		phc_print();
+
+	if (plget->trace_file && trace_write(plget->trace_file))
+		ret = -EIO;
+
+	if (plget->csv_file && trace_write_csv(plget->csv_file))
+		ret = -EIO;
+
+	if (plget->json_file && res_json_write(plget->json_file))
+		ret = -EIO;
+
+	if (plget->base_file) {
+		reg = base_compare(plget->base_file);
+		if (reg && !ret)
+			ret = reg < 0 ? reg : BASE_REGRESSED;
+	}
+
 	free(plget);
 
 	if (ret)
@@ -15,7 +15,7 @@
 #ifndef PLGET_H
 #define PLGET_H
 
-#include <netpacket/packet.h>
+#include <linux/if_packet.h>
 #include <net/ethernet.h>
 #include <netinet/in.h>
 #include <net/if.h>
@@ -33,8 +33,11 @@
 #define MAGIC				0x34
 #define SEQ_ID_MASK			0x3fff
 #define STREAM_ID_SHIFT			14
+#define RX_TIMEOUT			5000	/* ms, default */
 
 extern struct stats tx_app_v;
+extern struct stats tx_plan_v;
+extern struct stats tx_txtime_v;
 extern struct stats *tx_sch_v;
 extern struct stats tx_sw_v;
 extern struct stats tx_hw_v;
@@ -42,8 +45,6 @@ extern struct stats rx_app_v;
 extern struct stats rx_sw_v;
 extern struct stats rx_hw_v;
 
-extern struct stats temp;
-
 extern struct plgett *plget;
 
 #define BIT(X)				(1 << (X))
@@ -67,6 +68,10 @@ extern struct plgett *plget;
 #define PLF_SW_POLL			BIT(17)
 #define PLF_RTIME			BIT(18)
 #define PLF_STRICT_ID_ORDER		BIT(19)
+#define PLF_CONTINUOUS			BIT(20)
+#define PLF_PHC_DEV			BIT(21)
+#define PLF_TX_RING			BIT(22)
+#define PLF_QDISC_BYPASS		BIT(23)
 
 #define PLF_PRINTOUT			(PLF_HW_STAT |\
 					PLF_IPGAP_STAT |\
@@ -102,7 +107,8 @@ struct plgett {
 	struct sockaddr_ll sk_addr;
 	enum test_mod mod;
 	struct timespec interval;
-	struct timespec rtime;
+	struct timespec report;	/* interval summary period, 0 - no summary */
+	__s64 rtime;		/* relative time for hwts, in ns */
 	char if_name[IFNAMSIZ];
 	int ifidx;
 	int phc_idx;
@@ -118,7 +124,42 @@ struct plgett {
 	int busypoll_time;
 	int stream_id;
 	int dev_deep;
+	int hist_digits;	/* histogram backend precision, 0 - raw ts */
+	char *ts_file;		/* file to back raw ts vectors, NULL - RAM */
+	char *trace_file;	/* binary per-packet trace, NULL - no */
+	char *json_file;	/* JSON summary, NULL - no */
+	char *csv_file;		/* CSV per-packet ts, NULL - no */
+	char *metrics_addr;	/* OpenMetrics exporter address, NULL - no */
+	char *base_file;	/* baseline trace to compare with, NULL - no */
+	__u64 ts_fail;		/* packets w/o SCM_TIMESTAMPING */
+	__u64 rx_pkts;		/* rx-rate counters */
+	__u64 rx_bytes;
+	int worst_num;		/* slowest packets to report, 0 - no */
+	__s64 gap_tol;		/* gap conformance tolerance, ns */
+	int rx_timeout;		/* ms w/o packets to stop rx, 0 - wait */
+	int clk_reads;		/* reads per clock in clock benchmark */
+
+	/* send schedule, slot k is at slot0 + k * interval */
+	__s64 slot0;		/* first timer expiration, CLOCK_REALTIME ns */
+	__u64 slots_missed;	/* expired w/o packet sent, collapsed */
+	__u64 sends_late;	/* sent a period or more behind schedule */
+	__s64 send_lag_max;
+	__s64 mono0;		/* same slot 0, CLOCK_MONOTONIC ns */
+	__s64 pace_guard;	/* timer wakes up before slot, rest spun, ns */
+	int batch;		/* packets per sendmmsg in pkt-gen w/o pps */
+	int threads;		/* pkt-gen w/o pps senders */
+	int burst;		/* back-to-back packets per send slot */
+	__u64 send_calls;	/* send syscalls of pkt-gen w/o pps */
+	__s64 send_time;	/* ns spent in them */
 	int timer_fd;
+	volatile int stop;	/* SIGINT/SIGTERM in continuous mode */
+
+	/* SO_TXTIME, slot k is launched at txtime0 + k * interval */
+	__s64 txtime_lead;	/* launch time after wake up, ns, 0 - no */
+	__s64 txtime0;		/* CLOCK_TAI ns */
+	__s64 tai_off;		/* CLOCK_TAI - CLOCK_REALTIME, ns */
+	__u64 txtime_missed;	/* dropped, launch time passed */
+	__u64 txtime_invalid;	/* dropped, launch time rejected */
 	struct xsock *xsk;	/* xdp soket info */
 
 	/* rt print */
@@ -143,6 +184,7 @@ struct plgett {
 };
 
 int setup_sock(int sfd, int flags);
+int plget_tx_socket(int prio);
 
 int plget_create_timer(void);
 int plget_start_timer(void);
@@ -161,13 +203,16 @@ static inline char *magic_rd(void)
 	return (char *)(plget->data + plget->off_magic_rd);
 }
 
-static inline void tid_wr(__u32 tid)
+/* tid of packet built in pkt, plget->pkt or its copy */
+static inline void pkt_tid_wr(char *pkt, __u32 tid)
 {
-	char *p;
-
-	p = (char *)(plget->off_tid_wr + plget->pkt);
 	tid = htonl(tid);
-	memcpy(p, &tid, sizeof(tid));
+	memcpy(pkt + plget->off_tid_wr, &tid, sizeof(tid));
+}
+
+static inline void tid_wr(__u32 tid)
+{
+	pkt_tid_wr(plget->pkt, tid);
 }
 
 static inline __u32 tid_rd(void)
@@ -196,15 +241,23 @@ static inline __u32 tid_rx_rd(void)
 	return tid;
 }
 
-static inline void sid_wr(__u16 sid)
+/* PTP stream id of received packet */
+static inline int sid_rx_stream(void)
 {
-	char *p1, *p2;
+	__u16 sid;
 
-	p1 = (char *)&sid;
-	p2 = plget->off_sid_wr + plget->pkt;
+	memcpy(&sid, plget->rx_pkt + plget->off_sid_wr, sizeof(sid));
+	return ntohs(sid) >> STREAM_ID_SHIFT;
+}
 
-	*p2++ = *p1++;
-	*p2 = *p1;
+static inline void pkt_sid_wr(char *pkt, __u16 sid)
+{
+	memcpy(pkt + plget->off_sid_wr, &sid, sizeof(sid));
+}
+
+static inline void sid_wr(__u16 sid)
+{
+	pkt_sid_wr(plget->pkt, sid);
 }
 
 #endif
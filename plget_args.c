@@ -19,6 +19,11 @@
 #include <arpa/inet.h>
 #include <string.h>
 #include "xdp_prog_load.h"
+#include "result.h"
+#include "worst.h"
+#include "clk.h"
+#include "pkt_gen.h"
+#include "burst.h"
 
 #define PLGET_NAME_VER			"plget v0.5"
 #define PTP_EVENT_PORT			319
@@ -45,13 +50,18 @@ fprintf(s, "\ti NAME\t\t--if=NAME\t\t:interface name\n");
 fprintf(s, "\tm MODE\t\t--mode=MODE\t\t:\"rx-lat\" or \"tx-lat\" or "
 	"\"echo-lat\" or \"pkt-gen\" or \"rtt\" or \"rx-rate\" mode\n");
 fprintf(s, "\tn NUM\t\t--pkt-num=NUM\t\t:number of packets to be sent or "
-	"received\n");
+	"received, 0 - continuous mode,\n");
+fprintf(s, "\t\t\t\t\t\tmeasure until killed with histogram backend "
+	"and interval summary each second\n");
 fprintf(s, "\tl SIZE\t\t--frame-size=SIZE\t:packet frame size (total) in "
 	"bytes\n");
 fprintf(s, "\ta ADDR\t\t--address=ADDR\t\t:ip or mac address depending on the "
 	"mode\n");
-fprintf(s, "\tc \t\t--clock-check\t\t:print title along with system and "
-	"ptp clock counts, no arguments\n");
+fprintf(s, "\tc \t\t--clock-check\t\t:print title along with read cost "
+	"and resolution of system, ptp\n");
+fprintf(s, "\t\t\t\t\t\tand cpu counter clocks, no arguments\n");
+fprintf(s, "\tK NUM\t\t--clock-reads=NUM\t:reads per clock for -c, "
+	"10000 by default\n");
 
 fprintf(s, "\tf PRINTLINE\t--format=PRINTLINE\t:printout conf, \"hwts\" "
 	"\"ipgap\" \"plain\" \"lat\", by default \"lat\" is used\n");
@@ -80,14 +90,95 @@ fprintf(s, "\t\t\t\t\t\tThat is, if vlan + bridge then -d 3, and so on, "
 	"basically it's equal to\n");
 fprintf(s, "\t\t\t\t\t\tnumber of sched timestamps expected\n");
 
+fprintf(s, "\tg DIGITS\t--hist=DIGITS\t\t:use constant memory histogram "
+	"backend instead of raw ts vectors,\n");
+fprintf(s, "\t\t\t\t\t\twith DIGITS (1-4) significant digits "
+	"precision, \"hwts\" and \"plain\" need raw ts\n");
+
+fprintf(s, "\tx FILE\t\t--ts-file=FILE\t\t:back raw ts vectors with memory "
+	"mapped FILE instead of RAM,\n");
+fprintf(s, "\t\t\t\t\t\tfor captures bigger than RAM, can't be used "
+	"with histogram backend\n");
+
+fprintf(s, "\ty FILE\t\t--trace=FILE\t\t:write binary per-packet trace of "
+	"raw ts to FILE, see\n");
+fprintf(s, "\t\t\t\t\t\tplget_plotter/pltrace to read it, can't be "
+	"used with histogram backend\n");
+
+fprintf(s, "\tJ FILE\t\t--json=FILE\t\t:write JSON summary of all printed "
+	"results and run parameters\n");
+fprintf(s, "\t\t\t\t\t\tto FILE, latencies and gaps are in ns\n");
+
+fprintf(s, "\tC FILE\t\t--csv=FILE\t\t:write CSV of per-packet ts in ns "
+	"to FILE, row per packet,\n");
+fprintf(s, "\t\t\t\t\t\tcan't be used with histogram backend\n");
+
+fprintf(s, "\tB FILE\t\t--baseline=FILE\t\t:compare latencies with baseline "
+	"trace written with -y, by KS\n");
+fprintf(s, "\t\t\t\t\t\ttest and percentile deltas, exit with 3 if "
+	"some stage regressed\n");
+
+fprintf(s, "\tM ADDR\t\t--metrics=ADDR\t\t:serve OpenMetrics over HTTP on "
+	"[IP:]PORT (127.0.0.1 by default)\n");
+fprintf(s, "\t\t\t\t\t\tor UNIX socket if ADDR is path, latency "
+	"histograms, ts, loss and send counters\n");
+
+fprintf(s, "\te LIST\t\t--percentiles=LIST\t:comma separated list of "
+	"percentiles to report for latencies\n");
+fprintf(s, "\t\t\t\t\t\tand gaps, by default "
+	"\"50,90,99,99.9,99.99,99.999\"\n");
+
+fprintf(s, "\tv NUM\t\t--worst=NUM\t\t:report NUM slowest packets with "
+	"all their ts, tid, rx cpu and\n");
+fprintf(s, "\t\t\t\t\t\tpreceding gap, latency is from first to last "
+	"ts of packet, up to 1024\n");
+
+fprintf(s, "\tT NS\t\t--gap-tol=NS\t\t:\"ipgap\" conformance tolerance, "
+	"gaps are checked against 1/PPS\n");
+fprintf(s, "\t\t\t\t\t\tperiod if -s is set, by default 10%% of "
+	"period, for rx-lat -s is expected rate\n");
+
+fprintf(s, "\tG NUM\t\t--batch=NUM\t\t:pkt-gen w/o -s submits NUM packets "
+	"per sendmmsg, each with\n");
+fprintf(s, "\t\t\t\t\t\town id, 1 - sendto per packet, by default\n");
+
+fprintf(s, "\tW NUM\t\t--threads=NUM\t\t:pkt-gen w/o -s sends from NUM "
+	"threads pinned to own cpus,\n");
+fprintf(s, "\t\t\t\t\t\teach with own socket, tid space and PTP stream "
+	"id, -p PRIO is +1 per thread\n");
+
+fprintf(s, "\tD NS\t\t--txtime=NS\t\t:tx-lat sends with SO_TXTIME, "
+	"launch time of each packet\n");
+fprintf(s, "\t\t\t\t\t\tis on whole -s periods of CLOCK_TAI, NS after "
+	"wake up, for ETF/taprio\n");
+
+fprintf(s, "\tN NUM\t\t--burst=NUM\t\t:paced tx-lat and pkt-gen send "
+	"NUM packets back-to-back\n");
+fprintf(s, "\t\t\t\t\t\teach slot, with one sendmmsg or tx ring "
+	"kick, for CBS/taprio tests\n");
+
+fprintf(s, "\tS NS\t\t--spin=NS\t\t:paced send wakes up NS before "
+	"each slot and busy-spins\n");
+fprintf(s, "\t\t\t\t\t\tthe rest on CLOCK_MONOTONIC, for tx-lat, "
+	"pkt-gen, rtt and echo-lat\n");
+
+fprintf(s, "\tR MS\t\t--rx-timeout=MS\t\t:stop receiving if no packets "
+	"for MS since first one and report\n");
+fprintf(s, "\t\t\t\t\t\tloss, 5000 by default, 0 - wait for all "
+	"packets\n");
+
+fprintf(s, "\tj SEC\t\t--report=SEC\t\t:print count, loss and "
+	"min/p50/p99/max latencies over last SEC\n");
+fprintf(s, "\t\t\t\t\t\tseconds while running, fractional can be "
+	"used, 1 by default in continuous mode\n");
+
 fprintf(s, "\tq QUEUE\t\t--queue=QUEUE\t\t:set queue for xpd socket\n");
 fprintf(s, "\tz \t\t--zero-copy\t\t:force zero-copy XDP mode (not tested)\n");
 
 fprintf(s, "\to \t\t--option\t\t:can set the following options via comma: \n");
 fprintf(s, "\t\t\t\t\t\t\"dis_hwts\" - disable h/w ts, usefull to check "
 	"possible impact of mmio calls while h/w ts retrieve\n");
-fprintf(s, "\t\t\t\t\t\t\"clock_check\" - print title along with system "
-	"and ptp clock counts\n");
+fprintf(s, "\t\t\t\t\t\t\"clock_check\" - same as -c\n");
 fprintf(s, "\t\t\t\t\t\t\"ts_info\" - print timestamp capabilities and "
 	"configuration\n");
 fprintf(s, "\t\t\t\t\t\t\"progress\" - print progress bar while running\n");
@@ -97,6 +188,14 @@ fprintf(s, "\t\t\t\t\t\t\"sw_poll\" - software poll of ingress packets, "
 fprintf(s, "\t\t\t\t\t\t\"strict_order\" - receive packets only in strict "
 	   "order, one by one, no packet reordering, applicable only in "
 	   "rx-lat mode\n");
+fprintf(s, "\t\t\t\t\t\t\"phc_dev\" - sample PHC vs system clock while "
+	   "running and print offset, frequency drift, Allan deviation and "
+	   "TDEV\n");
+fprintf(s, "\t\t\t\t\t\t\"tx_ring\" - send raw_ptpl2 packets through "
+	   "PACKET_MMAP TX ring, frames are built in the ring once, kicked "
+	   "once per -G packets in pkt-gen w/o -s\n");
+fprintf(s, "\t\t\t\t\t\t\"qdisc_bypass\" - send packet socket packets "
+	   "directly to the driver queue, w/o qdisc\n");
 
 }
 
@@ -110,12 +209,30 @@ static struct option plget_options[] = {
 	{"frame-size",	required_argument,	0, 'l'},
 	{"address",	required_argument,	0, 'a'},
 	{"clock-check",	no_argument,		0, 'c'},
+	{"clock-reads",	required_argument,	0, 'K'},
 	{"format",	required_argument,	0, 'f'},
 	{"prio",	required_argument,	0, 'p'},
 	{"busy-poll",	required_argument,	0, 'w'},
 	{"rel-time",	required_argument,	0, 'r'},
 	{"stream-id",	required_argument,	0, 'k'},
 	{"dev-deep",	required_argument,	0, 'd'},
+	{"hist",	required_argument,	0, 'g'},
+	{"percentiles",	required_argument,	0, 'e'},
+	{"ts-file",	required_argument,	0, 'x'},
+	{"trace",	required_argument,	0, 'y'},
+	{"json",	required_argument,	0, 'J'},
+	{"csv",		required_argument,	0, 'C'},
+	{"metrics",	required_argument,	0, 'M'},
+	{"baseline",	required_argument,	0, 'B'},
+	{"report",	required_argument,	0, 'j'},
+	{"worst",	required_argument,	0, 'v'},
+	{"gap-tol",	required_argument,	0, 'T'},
+	{"rx-timeout",	required_argument,	0, 'R'},
+	{"batch",	required_argument,	0, 'G'},
+	{"txtime",	required_argument,	0, 'D'},
+	{"threads",	required_argument,	0, 'W'},
+	{"spin",	required_argument,	0, 'S'},
+	{"burst",	required_argument,	0, 'N'},
 	{"queue",	required_argument,	0, 'q'},
 	{"zero-copy",	no_argument,		0, 'z'},
 	{"help",	no_argument,		0, 'h'},
@@ -162,12 +279,37 @@ static void plget_check_args(void)
 	if (plget->flags & PLF_TITLE && (plget->if_name[0] == '\0'))
 		plget_fail("To print PHC clock info dev has to be specified");
 
+	if (plget->flags & PLF_PHC_DEV && (plget->if_name[0] == '\0'))
+		plget_fail("To sample PHC dev has to be specified");
+
 	if (mod == RX_RATE)
 		plget->flags &= ~PLF_RT_PRINT;
 
-	if (mod && mod != PKT_GEN && !plget->pkt_num)
+	if (mod && mod != PKT_GEN && !plget->pkt_num &&
+	    !(plget->flags & PLF_CONTINUOUS))
 		plget_fail("packet num has to be given if not pkt-gen mode");
 
+	if (plget->flags & PLF_CONTINUOUS && mod != PKT_GEN) {
+		if (mod == RX_RATE)
+			plget_fail("continuous mode is for latency modes only");
+
+		if (plget->flags & PLF_RT_PRINT)
+			plget_fail("no progress in continuous mode");
+
+		if (plget->ts_file || plget->trace_file || plget->csv_file ||
+		    plget->flags & (PLF_HW_STAT | PLF_PLAIN_FORMAT))
+			plget_fail("continuous mode keeps no raw ts, ts file, "
+				   "trace, csv, \"hwts\" and \"plain\" cannot be "
+				   "used in it");
+
+		/* memory has to be fixed whatever run time is */
+		if (!plget->hist_digits)
+			plget->hist_digits = RES_REPORT_DIGITS;
+
+		if (!ts_correct(&plget->report))
+			plget->report.tv_sec = 1;
+	}
+
 	if (plget->flags & PLF_SCHED_STAT) {
 		/* as always present some packet scheduler
 		 * TODO: identify virtual interface and increase to 2
@@ -190,8 +332,64 @@ static void plget_check_args(void)
 		       "this mode\n");
 	}
 
-	if (mod == RX_LAT && ts_correct(&plget->interval))
-		plget_fail("pps cannot be set in rx-lat mode");
+	if (plget->hist_digits &&
+	    plget->flags & (PLF_HW_STAT | PLF_PLAIN_FORMAT))
+		plget_fail("\"hwts\" and \"plain\" formats need raw ts, "
+			   "cannot be used with histogram backend");
+
+	if (plget->hist_digits &&
+	    (plget->ts_file || plget->trace_file || plget->csv_file))
+		plget_fail("histogram backend doesn't keep raw ts, ts file, "
+			   "trace or csv cannot be used with it");
+
+	if ((mod == PKT_GEN || mod == RX_RATE) && plget->base_file)
+		plget_fail("baseline can be compared in latency modes only");
+
+	if (plget->flags & PLF_TX_RING && (plget->pkt_type != PKT_RAW ||
+	    (mod != TX_LAT && mod != PKT_GEN)))
+		plget_fail("tx ring is for raw_ptpl2 tx-lat and pkt-gen only");
+
+	if (plget->flags & PLF_QDISC_BYPASS && plget->pkt_type != PKT_RAW &&
+	    plget->pkt_type != PKT_ETH)
+		plget_fail("qdisc can be bypassed for packet sockets only");
+
+	if (plget->flags & PLF_QDISC_BYPASS && plget->flags & PLF_SCHED_STAT)
+		plget_fail("no sched ts w/o qdisc, \"sched\" can't be used "
+			   "with qdisc bypass");
+
+	if (plget->txtime_lead && (mod != TX_LAT ||
+	    plget->flags & PLF_TX_RING || plget->pkt_type == PKT_XDP))
+		plget_fail("txtime is for tx-lat w/o tx ring and af_xdp only");
+
+	if (plget->pace_guard && (mod == RX_LAT || mod == RX_RATE ||
+	    !ts_correct(&plget->interval)))
+		plget_fail("spin is for tx-lat, pkt-gen, rtt and echo-lat "
+			   "with -s only");
+
+	if (plget->pace_guard && plget->pace_guard >=
+	    plget->interval.tv_sec * NSEC_PER_SEC + plget->interval.tv_nsec)
+		plget_fail("spin has to be shorter than send period");
+
+	if (plget->threads > 1 && (mod != PKT_GEN ||
+	    ts_correct(&plget->interval) || plget->flags & PLF_TX_RING))
+		plget_fail("threads are for pkt-gen w/o pps and w/o tx ring only");
+
+	if (plget->burst > 1 && ((mod != TX_LAT && mod != PKT_GEN) ||
+	    !ts_correct(&plget->interval) || plget->pkt_type == PKT_XDP))
+		plget_fail("burst is for tx-lat and pkt-gen with -s, w/o "
+			   "af_xdp only");
+
+	if (plget->batch > 1 && (mod != PKT_GEN ||
+	    ts_correct(&plget->interval)))
+		plget_fail("batch is for pkt-gen w/o pps only");
+
+	if ((mod == PKT_GEN || mod == RX_RATE) && plget->worst_num)
+		plget_fail("worst packets can be reported in latency modes only");
+
+	if (mod == RX_LAT && ts_correct(&plget->interval) &&
+	    !(plget->flags & PLF_IPGAP_STAT))
+		plget_fail("pps can be set in rx-lat mode only as expected "
+			   "rate for \"ipgap\"");
 
 	if ((mod == RX_LAT || mod == RX_RATE) && plget->flags & PLF_PRIO)
 		plget_fail("priority cannot be set in this mode");
@@ -399,15 +597,20 @@ static void plget_set_option(void)
 
 	if (strstr(optarg, "ts_info"))
 		plget->flags |= PLF_TS_INFO;
+
+	if (strstr(optarg, "phc_dev"))
+		plget->flags |= PLF_PHC_DEV;
+
+	if (strstr(optarg, "tx_ring"))
+		plget->flags |= PLF_TX_RING;
+
+	if (strstr(optarg, "qdisc_bypass"))
+		plget->flags |= PLF_QDISC_BYPASS;
 }
 
 static void plget_set_relative_time(void)
 {
-	__u64 ns;
-
-	sscanf(optarg, "%llu", &ns);
-	plget->rtime.tv_sec = ns / NSEC_PER_SEC;
-	plget->rtime.tv_nsec = ns - (__u64)plget->rtime.tv_sec * NSEC_PER_SEC;
+	sscanf(optarg, "%lld", &plget->rtime);
 	plget->flags |= PLF_RTIME;
 }
 
@@ -421,19 +624,63 @@ static void plget_set_stream_id(void)
 	plget->stream_id <<= STREAM_ID_SHIFT;
 }
 
+static void plget_set_hist(void)
+{
+	plget->hist_digits = atoi(optarg);
+
+	if (plget->hist_digits < HIST_MIN_DIGITS ||
+	    plget->hist_digits > HIST_MAX_DIGITS)
+		plget_fail("histogram precision has to be 1 - 4 digits");
+}
+
+static void plget_set_percentiles(void)
+{
+	double pct[STATS_PCT_MAX];
+	char *tok, *end;
+	int num = 0;
+
+	for (tok = strtok(optarg, ","); tok; tok = strtok(NULL, ",")) {
+		if (num == STATS_PCT_MAX)
+			plget_fail("too many percentiles");
+
+		pct[num++] = strtod(tok, &end);
+		if (end == tok || *end)
+			plget_fail("incorrect percentile");
+	}
+
+	if (stats_set_pct(pct, num))
+		plget_fail("percentiles have to be in range (0, 100]");
+}
+
 static void plget_set_pkt_num(void)
 {
 	plget->pkt_num = atoi(optarg);
 
-	if (plget->pkt_num == 0)
-		plget_fail("please provide countable packet number, but not 0");
+	if (plget->pkt_num < 0 || (!plget->pkt_num && strcmp(optarg, "0")))
+		plget_fail("please provide countable packet number");
+
+	if (!plget->pkt_num)
+		plget->flags |= PLF_CONTINUOUS;
+}
+
+static void plget_set_report(void)
+{
+	double sec;
+	char *end;
+
+	sec = strtod(optarg, &end);
+	if (end == optarg || *end || sec <= 0)
+		plget_fail("report interval has to be positive, in seconds");
+
+	plget->report.tv_sec = sec;
+	plget->report.tv_nsec = (sec - plget->report.tv_sec) * NSEC_PER_SEC;
 }
 
 static void read_args(int argc, char **argv)
 {
 	int idx, opt;
 
-	while ((opt = getopt_long(argc, argv, "s:u:p:i:m:n:l:a:t:f:b:cw:r:k:d:q:zho:",
+	while ((opt = getopt_long(argc, argv, "s:u:p:i:m:n:l:a:t:f:b:cK:w:r:k:d:g:e:x:y:J:C:M:B:j:v:T:R:G:D:W:S:N:q:zho:",
 	       plget_options, &idx)) != -1) {
 		switch (opt) {
 		case 's':
@@ -446,7 +693,9 @@ static void read_args(int argc, char **argv)
 			plget_set_packet_type();
 			break;
 		case 'i':
-			strncpy(plget->if_name, optarg, sizeof(plget->if_name));
+			strncpy(plget->if_name, optarg,
+				sizeof(plget->if_name) - 1);
+			plget->if_name[sizeof(plget->if_name) - 1] = 0;
 			plget->ifidx = if_nametoindex(plget->if_name);
 			break;
 		case 'n':
@@ -465,6 +714,11 @@ static void read_args(int argc, char **argv)
 		case 'c':
 			plget->flags |= PLF_TITLE;
 			break;
+		case 'K':
+			plget->clk_reads = atoi(optarg);
+			if (plget->clk_reads < 2)
+				plget_fail("clock reads has to be 2 or more");
+			break;
 		case 'f':
 			plget_set_output_format();
 			break;
@@ -485,6 +739,76 @@ static void read_args(int argc, char **argv)
 		case 'd':
 			plget->dev_deep = atoi(optarg);
 			break;
+		case 'g':
+			plget_set_hist();
+			break;
+		case 'e':
+			plget_set_percentiles();
+			break;
+		case 'x':
+			plget->ts_file = optarg;
+			break;
+		case 'y':
+			plget->trace_file = optarg;
+			break;
+		case 'J':
+			plget->json_file = optarg;
+			break;
+		case 'C':
+			plget->csv_file = optarg;
+			break;
+		case 'M':
+			plget->metrics_addr = optarg;
+			break;
+		case 'B':
+			plget->base_file = optarg;
+			break;
+		case 'j':
+			plget_set_report();
+			break;
+		case 'R':
+			plget->rx_timeout = atoi(optarg);
+			if (plget->rx_timeout < 0)
+				plget_fail("rx timeout has to be positive, in ms");
+			break;
+		case 'G':
+			plget->batch = atoi(optarg);
+			if (plget->batch < 1 ||
+			    plget->batch > PKT_GEN_BATCH_MAX)
+				plget_fail("batch has to be 1 - 1024");
+			break;
+		case 'W':
+			plget->threads = atoi(optarg);
+			if (plget->threads < 1 ||
+			    plget->threads > PKT_GEN_THREADS_MAX)
+				plget_fail("threads num has to be 1 - 64");
+			break;
+		case 'D':
+			plget->txtime_lead = atoll(optarg);
+			if (plget->txtime_lead <= 0)
+				plget_fail("txtime lead has to be positive, in ns");
+			break;
+		case 'N':
+			plget->burst = atoi(optarg);
+			if (plget->burst < 1 || plget->burst > BURST_MAX)
+				plget_fail("burst has to be 1 - 1024");
+			break;
+		case 'S':
+			plget->pace_guard = atoll(optarg);
+			if (plget->pace_guard <= 0)
+				plget_fail("spin has to be positive, in ns");
+			break;
+		case 'T':
+			plget->gap_tol = atoll(optarg);
+			if (plget->gap_tol <= 0)
+				plget_fail("gap tolerance has to be positive, in ns");
+			break;
+		case 'v':
+			plget->worst_num = atoi(optarg);
+			if (plget->worst_num <= 0 ||
+			    plget->worst_num > WORST_MAX)
+				plget_fail("worst packet num has to be 1 - 1024");
+			break;
 		case 'q':
 			plget->queue = atoi(optarg);
 			break;
@@ -517,6 +841,10 @@ void plget_fail(char *err)
 
 void plget_args(int argc, char **argv)
 {
+	plget->rx_timeout = RX_TIMEOUT;
+	plget->clk_reads = CLK_READS;
+	plget->batch = 1;
+	plget->burst = 1;
 	read_args(argc, argv);
 	plget_check_args();
 }
@@ -13,175 +13,398 @@
  */
 
 #include "plget_args.h"
+#include "result.h"
+#include "worst.h"
+#include "phc.h"
+#include "clk.h"
+#include "seq.h"
+#include "json.h"
+#include "trace.h"
+#include "pkt_gen.h"
+#include "pacer.h"
+#include "store.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <linux/sockios.h>
 #include <linux/ethtool.h>
 
-#define MEASUREMENTS_NUM		5
 #define NSEC_PER_USEC			1000ULL
 
-static void res_print_clock_info(int clock, char *clock_name)
+enum {
+	TX_DRV_LNK,		/* driver s/w ts -> wire */
+	TX_STACK_LNK,		/* app -> driver s/w ts */
+	TX_COMPL_LNK,		/* app -> wire */
+	TX_PLAN_LNK,		/* intended send time -> app */
+	TX_PLAN_SW_LNK,		/* intended send time -> driver s/w ts */
+	TX_PLAN_HW_LNK,		/* intended send time -> wire */
+	TX_LAUNCH_SW_LNK,	/* requested launch time -> driver s/w ts */
+	TX_LAUNCH_HW_LNK,	/* requested launch time -> wire */
+	TX_LNK_NUM
+};
+
+enum {
+	RX_DRV_LNK,		/* wire -> net subsystem */
+	RX_STACK_LNK,		/* net subsystem -> app */
+	RX_COMPL_LNK,		/* wire -> app */
+	RX_LNK_NUM
+};
+
+enum {
+	RTT_HW_LNK,
+	RTT_SW_LNK,
+	RTT_APP_LNK,
+	RTT_LNK_NUM
+};
+
+static struct stats_link tx_lnk[TX_LNK_NUM];
+static struct stats_link rx_lnk[RX_LNK_NUM];
+static struct stats_link rtt_lnk[RTT_LNK_NUM];
+static struct stats_link *sch_lnk;	/* dev_deep + 2 links */
+static char (*sch_name)[20];
+static int res_pnum;
+static int res_speed;
+
+/*
+ * Printout block, blocks are computed and formatted in parallel, each to
+ * its own buffer and with its own scratch, and emitted in order as soon as
+ * they are ready, while following ones are still computed.
+ */
+struct res_job {
+	char pre[128];		/* printed before the block */
+	char *str;
+	struct stats_link *l;	/* latency block */
+	struct stats *ss;	/* ts or gap block */
+	__s64 *rtime;
+	int flags;
+	int n;			/* number of packets in the block */
+	struct stats_sum sum;	/* numbers of the block, n = 0 if none */
+	char *buf;
+	size_t len;
+	int err;		/* errno if block couldn't be computed */
+	int done;
+};
+
+static struct res_job *jobs;
+static int job_num;
+static int job_next;
+static char res_pre_buf[128];
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t *job_thds;
+static int job_thd_num;
+
+static struct res_job *res_job_add(char *str, int flags)
 {
-	struct timespec res[MEASUREMENTS_NUM];
-	struct timespec ts1, ts2;
-	int res_is_avarage;
-	double aver_res;
-	int i, j, k;
-	__u64 val;
-	int ret;
+	struct res_job *j;
+
+	j = realloc(jobs, (job_num + 1) * sizeof(*jobs));
+	if (!j)
+		return NULL;
+
+	jobs = j;
+	j = &jobs[job_num++];
+	memset(j, 0, sizeof(*j));
+	memcpy(j->pre, res_pre_buf, sizeof(j->pre));
+	res_pre_buf[0] = 0;
+	j->str = str;
+	j->flags = flags;
+	return j;
+}
 
-	ret = clock_getres(clock, &ts1);
-	if (ret < 0)
-		perror("clock_getres");
+static void res_lat_print(char *str, struct stats_link *l, int flags)
+{
+	struct res_job *j = res_job_add(str, flags);
 
-	printf("-----------------------------------------\n");
-	printf("%s info:\n", clock_name);
-	printf("Declared resolution: %ldns\n", ts1.tv_nsec);
-	clock_gettime(clock, &ts1);
-	val = NSEC_PER_SEC * ts1.tv_sec + ts1.tv_nsec;
-	printf("Current time: %lluns\n", val);
-
-	for (j =0; j < MEASUREMENTS_NUM; j++) {
-		for (i = 0, k = 0; k < 8;) {
-			clock_gettime(clock, &ts1);
-			clock_gettime(clock, &ts2);
-
-			if (ts1.tv_nsec != ts2.tv_nsec) {
-				if (i > 1)
-					break;
-				else {
-					k++;
-					continue;
-				}
-			}
-			i++;
-		}
+	if (j)
+		j->l = l;
+}
+
+static void res_gap_print(char *str, struct stats *ss, int flags)
+{
+	struct res_job *j = res_job_add(str, flags | STATS_GAP_DATA);
+
+	if (j)
+		j->ss = ss;
+}
 
-		ts_sub(&ts2, &ts1, &res[j]);
-		if (res[j].tv_sec)
-			plget_fail("too long time diff");
+static void res_ts_print(char *str, struct stats *ss, int flags,
+			 __s64 *rtime)
+{
+	struct res_job *j = res_job_add(str, flags);
+
+	if (j) {
+		j->ss = ss;
+		j->rtime = rtime;
 	}
+}
+
+static int res_job_do(FILE *f, struct res_job *j)
+{
+	struct stats tmp = {0};
+	struct stats *ss = j->ss;
+	__s64 *ts;
+	int n;
+
+	if (j->l) {
+		if (!j->l->hist) {
+			ts = store_scratch(plget->pkt_num);
+			if (!ts)
+				return -errno;
+
+			stats_reserve_buf(&tmp, ts, plget->pkt_num);
+		}
 
-	/* check if res is real or average */
-	aver_res = res[0].tv_nsec;
-	for (i = 1; i < MEASUREMENTS_NUM; i++) {
-		if (res[i].tv_nsec != res[i-1].tv_nsec)
-			res_is_avarage = 1;
-		aver_res += res[i].tv_nsec;
+		n = stats_link_print(f, j->str, j->l, &tmp, j->flags,
+				     &j->sum);
+		store_scratch_free(tmp.start_ts);
+		return n;
 	}
 
-	if (res_is_avarage) {
-		aver_res /= MEASUREMENTS_NUM;
-		printf("Average \"userspace\" access resolution: %gns\n", aver_res);
-	} else {
-		printf("Real resolution: %ldns\n", res->tv_nsec);
-	}
-
-	/* Count in 1sec*/
-	clock_gettime(clock, &ts1);
-	printf("%s count:", clock_name);
-	for (i = 0; i < 3;) {
-		clock_gettime(clock, &ts2);
-		ts_sub(&ts2, &ts1, res);
-		if (res->tv_sec >= 1) {
-			ts1 = ts2;
-			printf(" %d", ++i);
-			fflush(stdout);
+	if (!(j->flags & STATS_GAP_DATA))
+		return stats_print(f, j->str, ss, j->flags, j->rtime, NULL);
+
+	if (ss->ids)
+		n = stats_hist_print(f, j->str, ss->gap, &j->sum) ? ss->cnt : 0;
+	else
+		n = stats_print(f, j->str, ss, j->flags, j->rtime, &j->sum);
+
+	if (ss->conf)
+		stats_conf_print(f, ss);
+
+	if (plget->burst > 1 && (ss == &tx_hw_v || ss == &tx_sw_v))
+		stats_burst_print(f, ss, plget->burst);
+
+	return n;
+}
+
+static void *res_job_worker(void *arg)
+{
+	struct res_job *j;
+	FILE *f;
+	int i;
+
+	for (;;) {
+		i = __atomic_fetch_add(&job_next, 1, __ATOMIC_RELAXED);
+		if (i >= job_num)
+			break;
+
+		j = &jobs[i];
+		f = open_memstream(&j->buf, &j->len);
+		if (f) {
+			fputs(j->pre, f);
+			j->n = res_job_do(f, j);
+			fclose(f);
+		} else {
+			j->n = -errno;
+		}
+
+		/* failed block is reported in place of it when emitted */
+		if (j->n < 0) {
+			j->err = -j->n;
+			j->n = 0;
 		}
+
+		pthread_mutex_lock(&job_lock);
+		j->done = 1;
+		pthread_cond_broadcast(&job_cond);
+		pthread_mutex_unlock(&job_lock);
 	}
-	printf("\n");
+
+	return NULL;
+}
+
+/* start computing blocks on all cpus in background */
+static void res_jobs_run(void)
+{
+	int i, thd_num = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t need, avail;
+
+	if (thd_num > job_num)
+		thd_num = job_num;
+
+	/*
+	 * raw vector job takes up to two ts copies, run no more of them than
+	 * free RAM fits, ts file scratch is paged as ts are instead
+	 */
+	need = 2 * plget->pkt_num * sizeof(__s64);
+	if (!plget->hist_digits && !plget->ts_file && need) {
+		avail = sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+		if (thd_num > avail / need)
+			thd_num = avail / need;
+	}
+
+	job_thds = calloc(thd_num, sizeof(*job_thds));
+	for (i = 0; job_thds && i < thd_num; i++) {
+		if (pthread_create(&job_thds[i], NULL, res_job_worker, NULL))
+			break;
+	}
+
+	/* no threads, compute all in place then */
+	job_thd_num = i;
+	if (!job_thd_num)
+		res_job_worker(NULL);
+}
+
+static void res_jobs_join(void)
+{
+	int i;
+
+	for (i = 0; i < job_thd_num; i++)
+		pthread_join(job_thds[i], NULL);
+
+	free(job_thds);
+	job_thd_num = 0;
 }
 
-static int res_tx_lat_print(void)
+/* whole block in one write, w/o copying to stdout buffer */
+static void res_job_write(struct res_job *j)
 {
-	struct timespec *rtime;
+	size_t off = 0;
+	ssize_t ret;
+
+	fflush(stdout);
+	while (off < j->len) {
+		ret = write(STDOUT_FILENO, j->buf + off, j->len - off);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+
+		off += ret;
+	}
+}
+
+/*
+ * emit blocks in order till "to", waiting for ones not computed yet,
+ * returns packet numbers ORed as before
+ */
+static int res_jobs_flush(int from, int to)
+{
+	int i, n = 0;
+
+	for (i = from; i < to; i++) {
+		pthread_mutex_lock(&job_lock);
+		while (!jobs[i].done)
+			pthread_cond_wait(&job_cond, &job_lock);
+		pthread_mutex_unlock(&job_lock);
+
+		if (jobs[i].buf)
+			res_job_write(&jobs[i]);
+
+		if (jobs[i].err)
+			printf("%s: cannot compute: %s\n\n", jobs[i].str,
+			       strerror(jobs[i].err));
+
+		free(jobs[i].buf);
+		jobs[i].buf = NULL;
+		n |= jobs[i].n;
+	}
+
+	return n;
+}
+
+static void res_tx_lat_print(void)
+{
+	__s64 *rtime;
 	int print_flags;
-	int n = 0;
 
 	print_flags = plget->flags & PLF_PLAIN_FORMAT ? STATS_PLAIN_OUTPUT : 0;
 
 	if (plget->flags & PLF_LATENCY_STAT) {
-		stats_diff(&tx_hw_v, &tx_sw_v, &temp);
-		n |= stats_print("\ndma + NIC tx latency, us (not complete "
-				 "driver latency, driver s/w ts -> wire)" ,
-				 &temp, print_flags, NULL);
+		res_lat_print("\ndma + NIC tx latency, us (not complete "
+			      "driver latency, driver s/w ts -> wire)" ,
+			      &tx_lnk[TX_DRV_LNK], print_flags);
+
+		res_lat_print("\nstack + packet scheduler + part of "
+			      "driver tx latency, us (app -> some place in "
+			      "the NIC driver, app -> driver s/w ts)",
+			      &tx_lnk[TX_STACK_LNK], print_flags);
+
+		res_lat_print("\ncomplete tx latency, us (driver latency "
+			      "+ stack latency, app -> wire)",
+			      &tx_lnk[TX_COMPL_LNK], print_flags);
+	}
 
-		stats_diff(&tx_sw_v, &tx_app_v, &temp);
-		n |= stats_print("\nstack + packet scheduler + part of "
-				 "driver tx latency, us (app -> some place in the "
-				 "NIC driver, app -> driver s/w ts)",
-				  &temp, print_flags, NULL);
+	/* w/o coordinated omission, stalled sends are not hidden */
+	if (tx_plan_v.size) {
+		res_lat_print("\nsend delay, us (intended send time -> app)",
+			      &tx_lnk[TX_PLAN_LNK], print_flags);
 
-		stats_diff(&tx_hw_v, &tx_app_v, &temp);
-		n |= stats_print("\ncomplete tx latency, us (driver latency + "
-				 "stack latency, app -> wire)",
-				  &temp, print_flags, NULL);
+		res_lat_print("\ntx latency from intended send time, us "
+			      "(intended send time -> driver s/w ts)",
+			      &tx_lnk[TX_PLAN_SW_LNK], print_flags);
+
+		res_lat_print("\ncomplete tx latency from intended send time, "
+			      "us (intended send time -> wire)",
+			      &tx_lnk[TX_PLAN_HW_LNK], print_flags);
+	}
+
+	/* SO_TXTIME, how close to requested time packets are launched */
+	if (tx_txtime_v.size) {
+		res_lat_print("\nlaunch accuracy by s/w ts, us (requested "
+			      "launch time -> driver s/w ts)",
+			      &tx_lnk[TX_LAUNCH_SW_LNK], print_flags);
+
+		res_lat_print("\nlaunch accuracy, us (requested launch time "
+			      "-> wire)", &tx_lnk[TX_LAUNCH_HW_LNK],
+			      print_flags);
 	}
 
 	if (plget->flags & PLF_SCHED_STAT) {
-		struct stats *v;
-		int i;
-
-		v = tx_sch_v;
-		stats_diff(v, &tx_app_v, &temp);
-		n |= stats_print("\nstack tx latency, us (based on s/w "
-				 "timestamps, app -> packet scheduler)",
-				  &temp, print_flags, NULL);
-
-		for (i = 1; i < plget->dev_deep; i++) {
-			printf("psched%d -> psched%d\n", i, i + 1);
-			stats_diff(&tx_sch_v[i], v, &temp);
-			n |= stats_print("\nbetween device (sched) tx latency, "
-					 "us (based on s/w timestamps, psched "
-					 "-> psched)",
-					 &temp, print_flags, NULL);
-			v = &tx_sch_v[i];
+		int i, d = plget->dev_deep;
+
+		res_lat_print("\nstack tx latency, us (based on s/w "
+			      "timestamps, app -> packet scheduler)",
+			      &sch_lnk[0], print_flags);
+
+		for (i = 1; i < d; i++) {
+			snprintf(res_pre_buf, sizeof(res_pre_buf),
+				 "psched%d -> psched%d\n", i, i + 1);
+			res_lat_print("\nbetween device (sched) tx "
+				      "latency, us (based on s/w "
+				      "timestamps, psched -> psched)",
+				      &sch_lnk[i], print_flags);
 		}
 
-		stats_diff(&tx_sw_v, v, &temp);
-		n |= stats_print("\npacket scheduler + part of driver tx "
-				 "latency, us (packet scheduler -> driver s/w "
-				 "ts)", &temp, print_flags, NULL);
+		res_lat_print("\npacket scheduler + part of driver tx "
+			      "latency, us (packet scheduler -> driver "
+			      "s/w ts)", &sch_lnk[d], print_flags);
 
-		stats_diff(&tx_hw_v, v, &temp);
-		n |= stats_print("\ndriver + packet scheduler tx latency, "
-				 "us (packet scheduler entrance -> wire)",
-				  &temp, print_flags, NULL);
+		res_lat_print("\ndriver + packet scheduler tx latency, "
+			      "us (packet scheduler entrance -> wire)",
+			      &sch_lnk[d + 1], print_flags);
 	}
 
 	if (plget->flags & PLF_HW_STAT) {
 		if (plget->flags & PLF_RTIME) {
 			rtime = &plget->rtime;
 		} else {
-			rtime = plget->mod == ECHO_LAT ? rx_hw_v.start_ts :
-							 tx_hw_v.start_ts;
+			rtime = plget->mod == ECHO_LAT ? &rx_hw_v.first :
+							 &tx_hw_v.first;
 		}
 
-		n |= stats_print("\nhw tx time, us", &tx_hw_v, print_flags,
-				 rtime);
+		res_ts_print("\nhw tx time, us", &tx_hw_v, print_flags, rtime);
 	}
 
 	if (plget->flags & PLF_IPGAP_STAT) {
 		if (plget->flags & PLF_DIS_HW_TS)
-			n |= stats_print("\ngap of sw tx time, us", &tx_sw_v,
-					  print_flags | STATS_GAP_DATA, NULL);
+			res_gap_print("\ngap of sw tx time, us", &tx_sw_v,
+				      print_flags);
 		else
-			n |= stats_print("\ngap of hw tx time, us", &tx_hw_v,
-					  print_flags | STATS_GAP_DATA, NULL);
+			res_gap_print("\ngap of hw tx time, us", &tx_hw_v,
+				      print_flags);
 	}
-
-	return n;
 }
 
-static int res_rx_lat_print(void)
+static void res_rx_lat_print(void)
 {
-	struct timespec *rtime;
+	__s64 *rtime;
 	int print_flags;
-	int n = 0;
 
 	print_flags = plget->flags & PLF_PLAIN_FORMAT ? STATS_PLAIN_OUTPUT : 0;
 
@@ -189,130 +412,317 @@ static int res_rx_lat_print(void)
 		if (plget->flags & PLF_RTIME)
 			rtime = &plget->rtime;
 		else
-			rtime = plget->mod == RTT_MOD ? tx_hw_v.start_ts :
-							rx_hw_v.start_ts;
+			rtime = plget->mod == RTT_MOD ? &tx_hw_v.first :
+							&rx_hw_v.first;
 
-		n |= stats_print("\nhw rx time, us", &rx_hw_v, print_flags,
-				 rtime);
+		res_ts_print("\nhw rx time, us", &rx_hw_v, print_flags, rtime);
 	}
 
 	if (plget->flags & PLF_IPGAP_STAT) {
 		if (plget->flags & PLF_DIS_HW_TS)
-			n |= stats_print("\ngap of sw rx time, us", &rx_sw_v,
-					 print_flags | STATS_GAP_DATA, NULL);
+			res_gap_print("\ngap of sw rx time, us", &rx_sw_v,
+				      print_flags);
 		else
-			n |= stats_print("\ngap of hw rx time, us", &rx_hw_v,
-					 print_flags | STATS_GAP_DATA, NULL);
-
-
+			res_gap_print("\ngap of hw rx time, us", &rx_hw_v,
+				      print_flags);
 	}
 
 	if (plget->flags & PLF_LATENCY_STAT) {
-		stats_diff(&rx_sw_v, &rx_hw_v, &temp);
-		n |= stats_print("\ndriver rx latency, us (no stack latency, "
-				 "wire -> net subsystem)",
-				 &temp, print_flags, NULL);
-		stats_diff(&rx_app_v, &rx_sw_v, &temp);
-		n |= stats_print("\nstack rx latency, us (no driver latency,  "
-				 "net subsystem -> app)",
-				 &temp, print_flags, NULL);
-		stats_diff(&rx_app_v, &rx_hw_v, &temp);
-		n |= stats_print("\ncomplete rx latency, us (driver latency + "
-				 "stack latency, wire -> app)",
-				 &temp, print_flags, NULL);
+		res_lat_print("\ndriver rx latency, us (no stack latency, "
+			      "wire -> net subsystem)",
+			      &rx_lnk[RX_DRV_LNK], print_flags);
+		res_lat_print("\nstack rx latency, us (no driver latency,  "
+			      "net subsystem -> app)",
+			      &rx_lnk[RX_STACK_LNK], print_flags);
+		res_lat_print("\ncomplete rx latency, us (driver latency + "
+			      "stack latency, wire -> app)",
+			      &rx_lnk[RX_COMPL_LNK], print_flags);
 	}
 
-	return n;
+}
+
+static struct stats *res_best_rx_vect(void)
+{
+	if (stats_first(&rx_hw_v))
+		return &rx_hw_v;
+	else if (stats_first(&rx_sw_v))
+		return &rx_sw_v;
+	else
+		return &rx_app_v;
+}
+
+static struct stats *res_best_tx_vect(void)
+{
+	if (stats_first(&tx_hw_v))
+		return &tx_hw_v;
+	else if (stats_first(&tx_sw_v))
+		return &tx_sw_v;
+	else
+		return &tx_app_v;
+}
+
+static char *res_ts_base(struct stats *ss)
+{
+	if (ss == &tx_hw_v || ss == &rx_hw_v)
+		return "hw";
+	else if (ss == &tx_sw_v || ss == &rx_sw_v)
+		return "sw";
+	else
+		return "app";
 }
 
 static void res_rtt_print(void)
 {
+	static struct stats_link lnk;
 	struct stats *a_stat, *b_stat;
-	char *a_ts_base, *b_ts_base;
-	int print_flags;
+	struct stats_link *l;
+	int print_flags, i;
 
 	print_flags = plget->flags & PLF_PLAIN_FORMAT ? STATS_PLAIN_OUTPUT : 0;
 
-	if (ts_correct(tx_hw_v.start_ts)) {
-		a_stat = &tx_hw_v;
-		a_ts_base = "hw";
-	} else if (ts_correct(tx_sw_v.start_ts)) {
-		a_stat = &tx_sw_v;
-		a_ts_base = "sw";
-	} else {
-		a_stat = &tx_app_v;
-		a_ts_base = "app";
+	a_stat = res_best_tx_vect();
+	b_stat = res_best_rx_vect();
+
+	/* links are collected for same ts base only */
+	l = NULL;
+	for (i = 0; i < RTT_LNK_NUM; i++) {
+		if (rtt_lnk[i].acc.n) {
+			l = &rtt_lnk[i];
+			break;
+		}
 	}
 
-	if (ts_correct(rx_hw_v.start_ts)) {
-		b_stat = &rx_hw_v;
-		b_ts_base = "hw";
-	} else if (ts_correct(rx_sw_v.start_ts)) {
-		b_stat = &rx_sw_v;
-		b_ts_base = "sw";
+	if (l) {
+		a_stat = l->b;
+		b_stat = l->a;
 	} else {
-		b_stat = &rx_app_v;
-		b_ts_base = "app";
+		memset(&lnk, 0, sizeof(lnk));
+		l = &lnk;
+		l->a = b_stat;
+		l->b = a_stat;
 	}
 
-	printf("RTT (round trip time) for this HOST based on "
-		"tx %s and rx %s timestamps\n", a_ts_base, b_ts_base);
+	snprintf(res_pre_buf, sizeof(res_pre_buf), "RTT (round trip time) for "
+		 "this HOST based on tx %s and rx %s timestamps\n",
+		 res_ts_base(a_stat), res_ts_base(b_stat));
 
-	stats_diff(b_stat, a_stat, &temp);
-	stats_print("\nRTT (no rx/tx latencies of this HOST, us",
-		    &temp, print_flags, NULL);
+	res_lat_print("\nRTT (no rx/tx latencies of this HOST, us", l,
+		      print_flags);
 }
 
-static struct stats *res_best_rx_vect(void)
+/* call fn for each latency link, in printout order */
+void res_for_each_link(void (*fn)(struct stats_link *l, void *arg),
+		       void *arg)
 {
-	if (ts_correct(rx_hw_v.start_ts))
-		return &rx_hw_v;
-	else if (ts_correct(rx_sw_v.start_ts))
-		return &rx_sw_v;
-	else
-		return &rx_app_v;
+	int i, d = plget->dev_deep;
+
+	for (i = 0; i < TX_LNK_NUM; i++)
+		fn(&tx_lnk[i], arg);
+
+	for (i = 0; sch_lnk && i < d + 2; i++)
+		fn(&sch_lnk[i], arg);
+
+	for (i = 0; i < RX_LNK_NUM; i++)
+		fn(&rx_lnk[i], arg);
+
+	for (i = 0; i < RTT_LNK_NUM; i++)
+		fn(&rtt_lnk[i], arg);
 }
 
-static struct stats *res_best_tx_vect(void)
+static void res_link_report_init(struct stats_link *l, void *arg)
 {
-	if (ts_correct(tx_hw_v.start_ts))
-		return &tx_hw_v;
-	else if (ts_correct(tx_sw_v.start_ts))
-		return &tx_sw_v;
-	else
-		return &tx_app_v;
+	int *ret = arg;
+
+	if (l->name)
+		*ret |= stats_link_ivl_init(l, plget->hist_digits ?
+					    plget->hist_digits :
+					    RES_REPORT_DIGITS);
+}
+
+/* gaps of printed gap vectors are checked against tx interval */
+static int res_conf_init(void)
+{
+	__s64 period, tol;
+	int mod = plget->mod;
+	int sw = plget->flags & PLF_DIS_HW_TS;
+	int ret = 0;
+
+	period = plget->interval.tv_sec * NSEC_PER_SEC +
+		 plget->interval.tv_nsec;
+	tol = plget->gap_tol ? plget->gap_tol : period / 10;
+	if (!tol)
+		tol = 1;
+
+	if (mod == RTT_MOD || mod == ECHO_LAT || mod == TX_LAT)
+		ret |= stats_conf_init(sw ? &tx_sw_v : &tx_hw_v, period, tol);
+
+	if (mod == RTT_MOD || mod == ECHO_LAT || mod == RX_LAT)
+		ret |= stats_conf_init(sw ? &rx_sw_v : &rx_hw_v, period, tol);
+
+	return ret;
+}
+
+int res_stats_init(void)
+{
+	int digits = plget->hist_digits;
+	int mod = plget->mod;
+	int i, d, ret = 0;
+	struct stats *v;
+
+	if (mod == RTT_MOD || mod == ECHO_LAT || mod == TX_LAT) {
+		if (plget->flags & PLF_LATENCY_STAT) {
+			ret |= stats_link_init(&tx_lnk[TX_DRV_LNK], "sw->hw",
+					       &tx_hw_v, &tx_sw_v, digits);
+			ret |= stats_link_init(&tx_lnk[TX_STACK_LNK], "app->sw",
+					       &tx_sw_v, &tx_app_v, digits);
+			ret |= stats_link_init(&tx_lnk[TX_COMPL_LNK], "app->hw",
+					       &tx_hw_v, &tx_app_v, digits);
+		}
+
+		if (tx_plan_v.size) {
+			ret |= stats_link_init(&tx_lnk[TX_PLAN_LNK], "plan->app",
+					       &tx_app_v, &tx_plan_v, digits);
+			ret |= stats_link_init(&tx_lnk[TX_PLAN_SW_LNK],
+					       "plan->sw", &tx_sw_v, &tx_plan_v,
+					       digits);
+			ret |= stats_link_init(&tx_lnk[TX_PLAN_HW_LNK],
+					       "plan->hw", &tx_hw_v, &tx_plan_v,
+					       digits);
+		}
+
+		if (tx_txtime_v.size) {
+			ret |= stats_link_init(&tx_lnk[TX_LAUNCH_SW_LNK],
+					       "launch->sw", &tx_sw_v,
+					       &tx_txtime_v, digits);
+			ret |= stats_link_init(&tx_lnk[TX_LAUNCH_HW_LNK],
+					       "launch->hw", &tx_hw_v,
+					       &tx_txtime_v, digits);
+		}
+
+		if (plget->flags & PLF_SCHED_STAT) {
+			d = plget->dev_deep;
+			sch_lnk = calloc(d + 2, sizeof(*sch_lnk));
+			if (!sch_lnk)
+				return -ENOMEM;
+
+			sch_name = calloc(d, sizeof(*sch_name));
+			if (!sch_name)
+				return -ENOMEM;
+
+			v = &tx_app_v;
+			for (i = 0; i < d; i++) {
+				snprintf(sch_name[i], sizeof(*sch_name),
+					 i ? "sched%d->sched%d" : "app->sched%d",
+					 i ? i : 1, i + 1);
+				ret |= stats_link_init(&sch_lnk[i], sch_name[i],
+						       &tx_sch_v[i], v, digits);
+				v = &tx_sch_v[i];
+			}
+
+			ret |= stats_link_init(&sch_lnk[d], "sched->sw",
+					       &tx_sw_v, v, digits);
+			ret |= stats_link_init(&sch_lnk[d + 1], "sched->hw",
+					       &tx_hw_v, v, digits);
+		}
+	}
+
+	if (mod == RTT_MOD || mod == ECHO_LAT || mod == RX_LAT) {
+		if (plget->flags & PLF_LATENCY_STAT) {
+			ret |= stats_link_init(&rx_lnk[RX_DRV_LNK], "hw->sw",
+					       &rx_sw_v, &rx_hw_v, digits);
+			ret |= stats_link_init(&rx_lnk[RX_STACK_LNK], "sw->app",
+					       &rx_app_v, &rx_sw_v, digits);
+			ret |= stats_link_init(&rx_lnk[RX_COMPL_LNK], "hw->app",
+					       &rx_app_v, &rx_hw_v, digits);
+		}
+	}
+
+	if (mod == RTT_MOD) {
+		ret |= stats_link_init(&rtt_lnk[RTT_HW_LNK], "rtt hw",
+				       &rx_hw_v, &tx_hw_v, digits);
+		ret |= stats_link_init(&rtt_lnk[RTT_SW_LNK], "rtt sw",
+				       &rx_sw_v, &tx_sw_v, digits);
+		ret |= stats_link_init(&rtt_lnk[RTT_APP_LNK], "rtt app",
+				       &rx_app_v, &tx_app_v, digits);
+	}
+
+	if (ts_correct(&plget->report))
+		res_for_each_link(res_link_report_init, &ret);
+
+	if (plget->flags & PLF_IPGAP_STAT && ts_correct(&plget->interval))
+		ret |= res_conf_init();
+
+	return ret;
+}
+
+/* summary of latencies computed so far, safe to call while measuring */
+static void res_link_summary(struct stats_link *l, void *arg)
+{
+	stats_link_summary(l);
+}
+
+void res_online_print(void)
+{
+	printf("\n");
+	res_for_each_link(res_link_summary, NULL);
+	fflush(stdout);
+}
+
+static void res_link_report_swap(struct stats_link *l, void *arg)
+{
+	if (l->ivl[0])
+		stats_link_ivl_swap(l);
+}
+
+static void res_link_report_print(struct stats_link *l, void *arg)
+{
+	if (l->ivl[0])
+		stats_link_ivl_print(stdout, arg, l);
+}
+
+/*
+ * res_report_print - print summary of last report interval ended at t
+ * seconds since start, called periodically while measuring
+ */
+void res_report_print(double t)
+{
+	char pre[32];
+
+	/* waits for writers to leave closed intervals */
+	res_for_each_link(res_link_report_swap, NULL);
+
+	snprintf(pre, sizeof(pre), "%9.3fs ", t);
+	res_for_each_link(res_link_report_print, pre);
+	fflush(stdout);
 }
 
 void res_title_print(void)
 {
 	struct timespec ts1, ts2, res;
-	int ptp_fd, phc_idx;
+	int ptp_fd = -1, phc_idx;
 	char phc_addr[20];
 
 	if (!(plget->flags & PLF_TITLE))
 		return;
 
-	res_print_clock_info(CLOCK_REALTIME, "CLOCK_REALTIME");
-
 	phc_idx = (plget->phc_idx == -1) ? 0 : plget->phc_idx;
 	snprintf(phc_addr, sizeof(phc_addr), "/dev/ptp%u", phc_idx);
 	if (access(phc_addr, 0)) {
 		printf("PHC %s is not registered\n", phc_addr);
-		goto ptp_err;
-	}
-
-	ptp_fd = open(phc_addr, O_RDWR);
-	if (ptp_fd == -1) {
-		perror("open PHC");
-		goto ptp_err;
+	} else {
+		ptp_fd = open(phc_addr, O_RDWR);
+		if (ptp_fd == -1)
+			perror("open PHC");
 	}
 
 	snprintf(phc_addr, sizeof(phc_addr), "PHC %u", phc_idx);
-	res_print_clock_info(ptp_fd, phc_addr);
+	clk_bench(ptp_fd, phc_addr, plget->clk_reads);
 	printf("-----------------------------------------\n");
+	if (ptp_fd == -1)
+		return;
 
 	/* Check roughly if timeline is same for Sys and PHC */
-	clock_gettime(ptp_fd, &ts1);
+	clock_gettime(PHC_CLOCKID(ptp_fd), &ts1);
 	clock_gettime(CLOCK_MONOTONIC, &ts2);
 	ts_sub(&ts2, &ts1, &res);
 	int usec_diff = res.tv_nsec / NSEC_PER_USEC;
@@ -322,7 +732,6 @@ void res_title_print(void)
 	printf("PHC vs CLOCK MONOTONIC = %lus %luns\n", res.tv_sec, res.tv_nsec);
 
 	close(ptp_fd);
-ptp_err:
 	printf("-----------------------------------------\n");
 }
 
@@ -360,6 +769,13 @@ int res_get_intf_speed(void)
 	return ethtool_cmd_speed(&edata);
 }
 
+static void res_rej_print(char *name, struct stats *ss)
+{
+	if (ss->rej)
+		printf("rejected %s ts (bad or duplicate id): %llu\n", name,
+		       ss->rej);
+}
+
 void res_stats_print(void)
 {
 	unsigned long long int ftt;
@@ -368,15 +784,26 @@ void res_stats_print(void)
 	int print_rx_lat = mod == RX_LAT || rx_tx_lat;
 	int print_tx_lat = mod == TX_LAT || rx_tx_lat;
 	int n = 0, n2 = 0;
+	int tx_jobs, rx_jobs;
 	int header_size;
 	int pnum, speed;
 
-	printf("\n");
 	if (print_tx_lat)
-		n2 = res_tx_lat_print();
+		res_tx_lat_print();
 
+	tx_jobs = job_num;
 	if (print_rx_lat)
-		n = res_rx_lat_print();
+		res_rx_lat_print();
+
+	rx_jobs = job_num;
+	if (mod == RTT_MOD)
+		res_rtt_print();
+
+	res_jobs_run();
+
+	printf("\n");
+	n2 = res_jobs_flush(0, tx_jobs);
+	n = res_jobs_flush(tx_jobs, rx_jobs);
 
 	if (mod == ECHO_LAT || mod == RTT_MOD) {
 		if (n != n2)
@@ -385,13 +812,15 @@ void res_stats_print(void)
 		pnum = n > n2 ? n2 : n;
 
 		if (mod == RTT_MOD)
-			res_rtt_print();
+			res_jobs_flush(rx_jobs, job_num);
 	} else if (mod == PKT_GEN) {
 		pnum = plget->pkt_num;
 	} else {
 		pnum = n | n2;
 	}
 
+	res_jobs_join();
+
 	if (mod == RX_LAT || mod == ECHO_LAT) {
 		header_size = (plget->pkt_type == PKT_RAW ||
 			       plget->pkt_type == PKT_XDP) ? 0 : ETH_HLEN;
@@ -404,6 +833,7 @@ void res_stats_print(void)
 
 	if (plget->frame_size) {
 		speed = res_get_intf_speed();
+		res_speed = speed;
 		printf("Interface speed returned: %dMbps\n", speed);
 		printf("Frame size: %d\n", plget->frame_size);
 		if (speed > 0) {
@@ -414,6 +844,39 @@ void res_stats_print(void)
 	}
 
 	printf("number of packets: %d\n", pnum);
+	res_pnum = pnum;
+
+	if (mod == TX_LAT || mod == PKT_GEN)
+		printf("missed send slots: %llu, late sends: %llu, "
+		       "max send lag: %lldns\n", plget->slots_missed,
+		       plget->sends_late, plget->send_lag_max);
+
+	pacer_print(stdout);
+
+	if (plget->txtime_lead)
+		printf("txtime drops: missed %llu, invalid %llu\n",
+		       plget->txtime_missed, plget->txtime_invalid);
+
+	if (plget->send_calls && plget->send_time > 0)
+		printf("send calls: %llu, %.1f packets per call, %.0f pps\n",
+		       plget->send_calls, (double)pnum / plget->send_calls,
+		       pnum * (double)NSEC_PER_SEC / plget->send_time);
+
+	if (mod == PKT_GEN)
+		pktgen_print(stdout);
+
+	if (print_tx_lat) {
+		res_rej_print("tx app", &tx_app_v);
+		res_rej_print("tx sw", &tx_sw_v);
+		res_rej_print("tx hw", &tx_hw_v);
+	}
+
+	if (print_rx_lat) {
+		res_rej_print("rx app", &rx_app_v);
+		res_rej_print("rx sw", &rx_sw_v);
+		res_rej_print("rx hw", &rx_hw_v);
+		seq_print(stdout);
+	}
 
 	if (mod == TX_LAT || mod == RTT_MOD)
 		stats_vrate_print(res_best_tx_vect(), plget->frame_size);
@@ -421,5 +884,222 @@ void res_stats_print(void)
 	if (mod == RX_LAT || mod == ECHO_LAT)
 		stats_vrate_print(res_best_rx_vect(), plget->frame_size);
 
+	if (plget->worst_num)
+		worst_print(stdout);
+
 	printf("\n");
 }
+
+static char *res_mod_name[] = {
+	[RX_LAT] = "rx-lat",
+	[TX_LAT] = "tx-lat",
+	[RTT_MOD] = "rtt",
+	[ECHO_LAT] = "echo-lat",
+	[PKT_GEN] = "pkt-gen",
+	[RX_RATE] = "rx-rate",
+};
+
+static char *res_pkt_name[] = {
+	[PKT_UDP] = "udp",
+	[PKT_ETH] = "eth",
+	[PKT_XDP] = "xdp",
+	[PKT_RAW] = "raw",
+};
+
+/* name of ts vector, same as trace column */
+static char *res_vect_name(struct stats *ss, struct trace_src *srcs, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++) {
+		if (srcs[i].ss == ss)
+			return srcs[i].name;
+	}
+
+	return "unknown";
+}
+
+static void res_json_run(struct json *j)
+{
+	double ipg;
+
+	ipg = (double)plget->interval.tv_sec * NSEC_PER_SEC +
+	      plget->interval.tv_nsec;
+
+	json_obj(j, "run");
+	json_str(j, "mode", res_mod_name[plget->mod]);
+	json_str(j, "if", plget->if_name);
+	json_str(j, "pkt_type", res_pkt_name[plget->pkt_type]);
+	json_int(j, "ptp", !!(plget->flags & PLF_PTP));
+	json_int(j, "pkt_num", plget->pkt_num);
+	json_dbl(j, "pps", ipg ? NSEC_PER_SEC / ipg : 0);
+	json_int(j, "interval_ns", ipg);
+	json_int(j, "frame_size", plget->frame_size);
+	json_int(j, "hist_digits", plget->hist_digits);
+	json_int(j, "dev_deep", plget->dev_deep);
+	json_int(j, "hwts", !(plget->flags & PLF_DIS_HW_TS));
+	json_end(j);
+
+	json_int(j, "speed_mbps", res_speed);
+	if (res_speed > 0)
+		json_dbl(j, "frame_time_ns",
+			 (double)plget->frame_size * 8 * 1000 / res_speed);
+	json_int(j, "packets", res_pnum);
+}
+
+static void res_json_conf(struct json *j, struct stats_conf *c)
+{
+	int b;
+
+	json_obj(j, "conformance");
+	json_int(j, "period_ns", c->period);
+	json_int(j, "tol_ns", c->tol);
+	json_uint(j, "n", c->n);
+	json_uint(j, "out", c->out);
+	json_uint(j, "bunched", c->bunch);
+	json_uint(j, "run_max", c->run_max ? c->run_max + 1 : 0);
+	json_uint(j, "missed", c->missed);
+	json_uint(j, "miss_gaps", c->miss_gaps);
+
+	/* bin b is error in [b - BINS / 2, b - BINS / 2 + 1) * tol */
+	json_arr(j, "bins");
+	for (b = 0; b < STATS_CONF_BINS; b++)
+		json_uint(j, NULL, c->bin[b]);
+	json_end(j);
+
+	json_end(j);
+}
+
+/* latency and gap blocks as printed, in ns */
+static void res_json_blocks(struct json *j, struct trace_src *srcs, int num)
+{
+	struct stats_sum *s;
+	char name[32];
+	struct res_job *jb;
+	int i, k;
+
+	json_arr(j, "blocks");
+	for (i = 0; i < job_num; i++) {
+		jb = &jobs[i];
+		s = &jb->sum;
+		if (!s->n)
+			continue;
+
+		if (jb->l)
+			snprintf(name, sizeof(name), "%s", jb->l->name);
+		else
+			snprintf(name, sizeof(name), "gap:%s",
+				 res_vect_name(jb->ss, srcs, num));
+
+		json_obj(j, NULL);
+		json_str(j, "name", name);
+		json_str(j, "title", jb->str + strspn(jb->str, "\n"));
+		json_uint(j, "n", s->n);
+		json_int(j, "min_ns", s->min);
+		json_int(j, "max_ns", s->max);
+		json_dbl(j, "mean_ns", s->mean);
+		json_dbl(j, "rms_ns", s->dev);
+		if (s->neg)
+			json_uint(j, "negative", s->neg);
+
+		json_obj(j, "percentiles_ns");
+		for (k = 0; k < s->pct_num; k++) {
+			snprintf(name, sizeof(name), "p%g", s->pct[k]);
+			json_int(j, name, s->val[k]);
+		}
+		json_end(j);
+
+		if (jb->ss && jb->ss->conf && jb->ss->conf->n)
+			res_json_conf(j, jb->ss->conf);
+
+		json_end(j);
+	}
+	json_end(j);
+}
+
+static void res_json_rate(struct json *j, struct stats *ss)
+{
+	__s64 ns = ss->last - ss->first;
+	__u64 n = ss->cnt;
+
+	if (n-- < 2 || ns <= 0)
+		return;
+
+	json_obj(j, "rate");
+	json_uint(j, "packets", n);
+	json_dbl(j, "pps", (double)n * NSEC_PER_SEC / ns);
+	json_dbl(j, "kbps", (double)plget->frame_size * n * 8 * USEC_PER_SEC /
+		 ns);
+	json_dbl(j, "period_ns", (double)ns / n);
+	json_end(j);
+}
+
+/*
+ * res_json_write - everything res_stats_print() printed, as one JSON
+ * object, has to be called after it
+ */
+int res_json_write(char *path)
+{
+	struct trace_src srcs[TRACE_COL_MAX];
+	int mod = plget->mod;
+	struct json j;
+	int i, num;
+	FILE *f;
+
+	f = fopen(path, "w");
+	if (!f)
+		return perror("open json"), -errno;
+
+	num = trace_collect(srcs);
+
+	json_begin(&j, f);
+	res_json_run(&j);
+	res_json_blocks(&j, srcs, num);
+
+	json_obj(&j, "rejected");
+	for (i = 0; i < num; i++) {
+		if (srcs[i].ss->rej)
+			json_uint(&j, srcs[i].name, srcs[i].ss->rej);
+	}
+	json_end(&j);
+
+	if (mod == TX_LAT || mod == PKT_GEN) {
+		json_obj(&j, "send");
+		json_uint(&j, "slots_missed", plget->slots_missed);
+		json_uint(&j, "late", plget->sends_late);
+		json_int(&j, "lag_max_ns", plget->send_lag_max);
+		if (plget->txtime_lead) {
+			json_int(&j, "txtime_lead_ns", plget->txtime_lead);
+			json_uint(&j, "txtime_missed", plget->txtime_missed);
+			json_uint(&j, "txtime_invalid", plget->txtime_invalid);
+		}
+		if (plget->send_calls && plget->send_time > 0) {
+			json_uint(&j, "calls", plget->send_calls);
+			json_dbl(&j, "pps", plget->pkt_num *
+				 (double)NSEC_PER_SEC / plget->send_time);
+		}
+		pktgen_json(&j);
+		json_end(&j);
+	}
+
+	pacer_json(&j);
+
+	if (mod == TX_LAT || mod == RTT_MOD)
+		res_json_rate(&j, res_best_tx_vect());
+
+	if (mod == RX_LAT || mod == ECHO_LAT)
+		res_json_rate(&j, res_best_rx_vect());
+
+	if (mod == RX_LAT || mod == ECHO_LAT || mod == RTT_MOD ||
+	    mod == RX_RATE)
+		seq_json(&j);
+
+	if (plget->worst_num)
+		worst_json(&j);
+
+	json_finish(&j);
+	if (fclose(f))
+		return perror("write json"), -EIO;
+
+	return 0;
+}
@@ -15,8 +15,19 @@
 #ifndef PLGET_RES_H
 #define PLGET_RES_H
 
+/* interval summary precision if no histogram backend precision is set */
+#define RES_REPORT_DIGITS	3
+
+struct stats_link;
+
 void res_title_print(void);
+int res_stats_init(void);
 void res_stats_print(void);
+int res_json_write(char *path);
+void res_online_print(void);
+void res_report_print(double t);
 void res_print_time(void);
+void res_for_each_link(void (*fn)(struct stats_link *l, void *arg),
+		       void *arg);
 
 #endif
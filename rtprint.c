@@ -13,8 +13,13 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
 #include "plget.h"
+#include "result.h"
 #include "debug.h"
 
 void *rtprint(void *arg)
@@ -41,3 +46,53 @@ void *rtprint(void *arg)
 
 	return 0;
 }
+
+/* print latencies computed so far on each SIGUSR1, it's blocked for others */
+void *rtsummary(void *arg)
+{
+	sigset_t set;
+	int sig;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+
+	for (;;) {
+		if (sigwait(&set, &sig))
+			break;
+
+		res_online_print();
+	}
+
+	return 0;
+}
+
+/* print summary of each report interval, till canceled */
+void *rtreport(void *arg)
+{
+	struct timespec start, next;
+	double t;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	next = start;
+
+	for (;;) {
+		next.tv_sec += plget->report.tv_sec;
+		next.tv_nsec += plget->report.tv_nsec;
+		if (next.tv_nsec >= NSEC_PER_SEC) {
+			next.tv_nsec -= NSEC_PER_SEC;
+			next.tv_sec++;
+		}
+
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		t = (next.tv_sec - start.tv_sec) +
+		    (next.tv_nsec - start.tv_nsec) / (double)NSEC_PER_SEC;
+
+		/* don't leave stdout locked if canceled */
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		res_report_print(t);
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+	}
+
+	return 0;
+}
@@ -16,5 +16,7 @@
 #define PLGET_RTPRINT_H
 
 void *rtprint(void *arg);
+void *rtsummary(void *arg);
+void *rtreport(void *arg);
 
 #endif
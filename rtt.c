@@ -17,6 +17,7 @@
 #include "rx_lat.h"
 #include "tx_lat.h"
 #include "rtt.h"
+#include "pacer.h"
 #include <stdio.h>
 #include <unistd.h>
 #include <poll.h>
@@ -28,8 +29,8 @@ static int rtt_proc(void)
 {
 	int sid = plget->stream_id;
 	struct pollfd fds;
+	uint64_t exps, slot = 0;
 	int timer, ret;
-	uint64_t exps;
 
 	timer = ts_correct(&plget->interval);
 	if (timer) {
@@ -41,8 +42,10 @@ static int rtt_proc(void)
 			return ret;
 	}
 
-	plget->inum = plget->pkt_num;
-	for (plget->icnt = 0; plget->icnt < plget->pkt_num; ++plget->icnt) {
+	/* continuous mode if no packet num */
+	plget->inum = plget->pkt_num ? plget->pkt_num : ~0;
+	for (plget->icnt = 0; plget->icnt < plget->inum && !plget->stop;
+	     ++plget->icnt) {
 		if (plget->flags & PLF_PTP)
 			sid_wr(htons((plget->icnt & SEQ_ID_MASK) | sid));
 
@@ -54,12 +57,17 @@ static int rtt_proc(void)
 			continue;
 
 		ret = poll(&fds, 1, MAX_LATENCY);
+		if (ret < 0 && errno == EINTR)
+			break;
 		if (ret <= 0)
 			return perror("Some error on timer poll()"), -errno;
 
 		ret = read(plget->timer_fd, &exps, sizeof(exps));
 		if (ret < 0)
 			return perror("Couldn't read timerfd"), -errno;
+
+		pacer_wait(slot);
+		slot += exps;
 	}
 
 	return 0;
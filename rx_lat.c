@@ -12,6 +12,7 @@
  * GNU General Public License for more details.
  */
 
+#define _GNU_SOURCE	/* sched_getcpu */
 #include <linux/net_tstamp.h>
 #include <time.h>
 #include <linux/errqueue.h>
@@ -25,6 +26,9 @@
 #include <poll.h>
 #include "xdp_sock.h"
 #include <string.h>
+#include <sched.h>
+#include "worst.h"
+#include "seq.h"
 
 #define RATE_INERVAL			1
 
@@ -45,6 +49,7 @@ static int rxlat_handle_ts(struct timespec *ts, __u32 ts_id)
 	}
 
 	if (!tss) {
+		plget->ts_fail++;
 		fprintf(stderr, "SCM_TIMESTAMPING not found!\n");
 		return -1;
 	}
@@ -60,11 +65,59 @@ static int rxlat_handle_ts(struct timespec *ts, __u32 ts_id)
 	stats_push_id(&rx_sw_v, tss->ts, ts_id);
 	stats_push_id(&rx_hw_v, tss->ts + 2, ts_id);
 	stats_push_id(&rx_app_v, ts, ts_id);
+
+	if (plget->worst_num)
+		worst_update(ts_id, sched_getcpu());
+
 	return 0;
 }
 
+static int rx_armed;		/* first packet is here, rx timeout is on */
+
+/* stop waiting if no packets for rx timeout since the first one */
+static void rxlat_arm_timeout(void)
+{
+	struct timeval tv;
+
+	rx_armed = 1;
+	tv.tv_sec = plget->rx_timeout / 1000;
+	tv.tv_usec = plget->rx_timeout % 1000 * 1000;
+	if (setsockopt(plget->sfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
+		perror("SO_RCVTIMEO");
+}
+
+/* same for polling, idle time is counted from first empty poll */
+static int rxlat_poll_timeout(struct timespec *from)
+{
+	struct timespec now;
+	__s64 ms;
+
+	if (plget->stop) {
+		errno = EINTR;
+		return 1;
+	}
+
+	if (!rx_armed || !plget->rx_timeout)
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!ts_correct(from)) {
+		*from = now;
+		return 0;
+	}
+
+	ms = (now.tv_sec - from->tv_sec) * 1000 +
+	     (now.tv_nsec - from->tv_nsec) / 1000000;
+	if (ms < plget->rx_timeout)
+		return 0;
+
+	errno = EAGAIN;
+	return 1;
+}
+
 static int rxlat_recvmsg_start(struct timespec *ts)
 {
+	struct timespec idle = {0};
 	int flags, psize;
 
 	if (plget->pkt_type == PKT_XDP) {
@@ -75,7 +128,7 @@ static int rxlat_recvmsg_start(struct timespec *ts)
 	flags = (plget->flags & PLF_SW_POLL) ? MSG_DONTWAIT : 0;
 	do
 		psize = recvmsg(plget->sfd, &plget->msg, flags);
-	while (psize <= 0 && flags);
+	while (psize <= 0 && flags && !rxlat_poll_timeout(&idle));
 
 	if (clock_gettime(CLOCK_REALTIME, ts))
 		return -1;
@@ -124,9 +177,16 @@ static int rxlat_recvmsg(struct timespec *ts, __u32 *ts_id)
 		magic = magic_rx_rd();
 		if (*magic == MAGIC) {
 			*ts_id = tid_rx_rd();
-			if (*ts_id > plget->pkt_num)
-				printf("incorrect ts_id\n");
-			break;
+			if (*ts_id < plget->pkt_num ||
+			    plget->flags & PLF_CONTINUOUS) {
+				seq_rx(plget->flags & PLF_PTP ?
+				       sid_rx_stream() : 0, *ts_id);
+				break;
+			}
+
+			/* foreign or corrupted packet, drop it */
+			printf("incorrect ts_id %u\n", *ts_id);
+			continue;
 		}
 
 		printf("incorrect rx MAGIC number 0x%x\n", *magic);
@@ -135,7 +195,11 @@ static int rxlat_recvmsg(struct timespec *ts, __u32 *ts_id)
 	return psize;
 }
 
-void rxlat_proc_packet(void)
+/*
+ * rxlat_proc_packet - receive packet and its ts
+ * Returns -ETIME if no packets for rx timeout
+ */
+int rxlat_proc_packet(void)
 {
 	struct timespec ts;
 	int psize, ret;
@@ -145,22 +209,40 @@ void rxlat_proc_packet(void)
 		plget->msg.msg_controllen = sizeof(plget->control);
 		psize = rxlat_recvmsg(&ts, &ts_id);
 
-		if (psize < 0)
-			return perror("recvmsg");
+		if (psize < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return -ETIME;
+
+			if (errno == EINTR && plget->stop)
+				return -EINTR;
+
+			return perror("recvmsg"), -errno;
+		}
 
 		ret = rxlat_handle_ts(&ts, ts_id);
 		if (!ret)
 			break;
 	}
 
+	if (!rx_armed && plget->rx_timeout && plget->pkt_type != PKT_XDP)
+		rxlat_arm_timeout();
+
 	plget->sk_payload_size = psize;
+	return 0;
 }
 
 int rxlat(void)
 {
-	plget->inum = plget->pkt_num;
-	for (plget->icnt = 0; plget->icnt < plget->pkt_num; ++plget->icnt)
-		rxlat_proc_packet();
+	/* continuous mode if no packet num */
+	plget->inum = plget->pkt_num ? plget->pkt_num : ~0;
+	for (plget->icnt = 0; plget->icnt < plget->inum && !plget->stop;
+	     ++plget->icnt) {
+		if (rxlat_proc_packet() == -ETIME) {
+			printf("no packets for %dms, stop waiting\n",
+			       plget->rx_timeout);
+			break;
+		}
+	}
 
 	return 0;
 }
@@ -178,6 +260,11 @@ static int rxrate_proc_packet(struct timespec *ts)
 		return perror("recvmsg"), -errno;
 	}
 
+	if (psize >= plget->off_tid_rx_rd + sizeof(__u32) &&
+	    *magic_rx_rd() == MAGIC)
+		seq_rx(plget->flags & PLF_PTP ? sid_rx_stream() : 0,
+		       tid_rx_rd());
+
 	plget->frame_size = psize;
 	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
 		if (cmsg->cmsg_level != SOL_SOCKET ||
@@ -189,6 +276,7 @@ static int rxrate_proc_packet(struct timespec *ts)
 	}
 
 	if (!tss) {
+		plget->ts_fail++;
 		fprintf(stderr, "SCM_TIMESTAMPING not found!\n");
 		return -1;
 	}
@@ -206,12 +294,13 @@ static int rxrate_proc_packet(struct timespec *ts)
 
 int rxrate_proc(void)
 {
-	struct timespec interval, first, last;
+	struct timespec interval, first, last, rx_ts, now;
 	int dsize = 0, pnum = 0, hw = 0;
 	int hsize = ETH_HLEN;
 	struct pollfd fds[2];
+	__s64 idle;
 	uint64_t exps;
-	int ret;
+	int ret, rx = 0;
 
 	if (plget->pkt_type == PKT_UDP)
 		hsize += 28;
@@ -236,8 +325,12 @@ int rxrate_proc(void)
 			if (hw >= 0) {
 				plget->frame_size += hsize;
 				dsize += plget->frame_size;
+				plget->rx_pkts++;
+				plget->rx_bytes += plget->frame_size;
 				if (!pnum++)
 					first = last;
+				clock_gettime(CLOCK_MONOTONIC, &rx_ts);
+				rx = 1;
 			}
 		}
 
@@ -247,6 +340,19 @@ int rxrate_proc(void)
 			if (ret < 0)
 				return perror("Couldn't read timerfd"), -errno;
 
+			/* stop with sequence report once traffic is over */
+			if (rx && plget->rx_timeout) {
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				idle = (now.tv_sec - rx_ts.tv_sec) *
+				       NSEC_PER_SEC + now.tv_nsec - rx_ts.tv_nsec;
+				if (idle >= plget->rx_timeout * 1000000LL) {
+					printf("no packets for %lldms, stop "
+					       "waiting\n", idle / 1000000);
+					seq_print(stdout);
+					break;
+				}
+			}
+
 			if (pnum <= 1) {
 				interval = plget->interval;
 			} else {
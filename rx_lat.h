@@ -19,6 +19,6 @@
 
 int rxlat(void);
 int rxrate(void);
-void rxlat_proc_packet(void);
+int rxlat_proc_packet(void);
 
 #endif
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stddef.h>
+#include "seq.h"
+#include "metrics.h"
+
+static struct seq_stream streams[SEQ_STREAMS];
+static __u32 seq_num;
+
+/*
+ * seq_init - num packets are expected per stream from tid 0, if 0 it's
+ * unknown and stream starts from first received tid
+ */
+void seq_init(__u32 num)
+{
+	seq_num = num;
+}
+
+static void seq_burst_end(struct seq_stream *s)
+{
+	int bin;
+
+	if (!s->burst)
+		return;
+
+	/* 1, 2, 3-4, 5-8... */
+	bin = s->burst == 1 ? 0 : 64 - __builtin_clzll(s->burst - 1);
+	if (bin >= SEQ_BURST_BINS)
+		bin = SEQ_BURST_BINS - 1;
+
+	s->burst_bin[bin]++;
+	s->burst_num++;
+	if (s->burst > s->burst_max)
+		s->burst_max = s->burst;
+
+	s->burst = 0;
+}
+
+/* move window tail to tid "to", not received tids left behind are lost */
+static void seq_evict(struct seq_stream *s, __u32 to)
+{
+	__u32 n = to - s->tail;
+	__u32 i, k;
+
+	k = n < SEQ_WIN ? n : SEQ_WIN;
+	for (i = 0; i < k; i++, s->tail++) {
+		if (s->seen[s->tail & (SEQ_WIN - 1)] == s->tail + 1) {
+			seq_burst_end(s);
+		} else {
+			s->lost++;
+			s->burst++;
+		}
+	}
+
+	/* far jump, these were never in window */
+	s->lost += n - k;
+	s->burst += n - k;
+	s->tail = to;
+}
+
+/*
+ * reordering extent of RFC 4737: distance in arrivals back to earliest
+ * packet with greater tid, only last SEQ_WIN arrivals are looked through
+ */
+static __u32 seq_extent(struct seq_stream *s, __u32 tid)
+{
+	__u64 i, last = s->arr_num - 1;
+
+	i = s->arr_num > SEQ_WIN ? s->arr_num - SEQ_WIN : 0;
+	for (; i < last; i++) {
+		if ((__s32)(s->arr[i & (SEQ_WIN - 1)] - tid) > 0)
+			return last - i;
+	}
+
+	return SEQ_WIN;
+}
+
+void seq_rx(int stream, __u32 tid)
+{
+	struct seq_stream *s = &streams[stream & (SEQ_STREAMS - 1)];
+	__u32 *seen = &s->seen[tid & (SEQ_WIN - 1)];
+	__u32 ext;
+
+	if (!s->active) {
+		s->active = 1;
+		s->next = seq_num ? 0 : tid;
+		s->tail = s->next;
+	}
+
+	if ((__s32)(tid - s->tail) < 0) {
+		s->late++;
+		return;
+	}
+
+	if (*seen == tid + 1) {
+		s->dup++;
+		return;
+	}
+
+	*seen = tid + 1;
+	s->rcv++;
+	s->arr[s->arr_num++ & (SEQ_WIN - 1)] = tid;
+
+	if ((__s32)(tid - s->next) >= 0) {
+		s->next = tid + 1;
+		if ((__s32)(s->next - s->tail) > SEQ_WIN)
+			seq_evict(s, s->next - SEQ_WIN);
+
+		return;
+	}
+
+	s->reord++;
+	ext = seq_extent(s, tid);
+	if (ext > s->ext_max)
+		s->ext_max = ext;
+}
+
+/* rest of window and tail of run if number is known, can be repeated */
+static void seq_stream_done(struct seq_stream *s)
+{
+	seq_evict(s, s->next);
+	if (seq_num && (__s32)(seq_num - s->next) > 0)
+		seq_evict(s, seq_num);
+	seq_burst_end(s);
+}
+
+static void seq_stream_print(FILE *f, int id, struct seq_stream *s)
+{
+	__u64 exp;
+	int i;
+
+	seq_stream_done(s);
+
+	/* late ones are received, but were counted as lost */
+	exp = s->rcv + s->lost;
+	fprintf(f, "stream %d: received %llu of %llu, lost %llu (%.3f%%), "
+		"duplicated %llu, reordered %llu (%.3f%%), max reorder extent "
+		"%u, late %llu\n", id, s->rcv + s->late, exp, s->lost - s->late,
+		exp ? 100.0 * (s->lost - s->late) / exp : 0, s->dup, s->reord,
+		s->rcv ? 100.0 * s->reord / s->rcv : 0, s->ext_max, s->late);
+
+	if (!s->burst_num)
+		return;
+
+	fprintf(f, "loss bursts: %llu, max %llu, by length:", s->burst_num,
+		s->burst_max);
+	for (i = 0; i < SEQ_BURST_BINS; i++) {
+		if (!s->burst_bin[i])
+			continue;
+
+		if (i < 2)
+			fprintf(f, " %d: %llu", i + 1, s->burst_bin[i]);
+		else if (i == SEQ_BURST_BINS - 1)
+			fprintf(f, " >%d: %llu", 1 << (i - 1), s->burst_bin[i]);
+		else
+			fprintf(f, " %d-%d: %llu", (1 << (i - 1)) + 1, 1 << i,
+				s->burst_bin[i]);
+	}
+
+	fprintf(f, "\n");
+}
+
+/* per stream summary, window is flushed so it's printed once at the end */
+void seq_print(FILE *f)
+{
+	int i;
+
+	for (i = 0; i < SEQ_STREAMS; i++) {
+		if (streams[i].active)
+			seq_stream_print(f, i, &streams[i]);
+	}
+}
+
+void seq_json(struct json *j)
+{
+	struct seq_stream *s;
+	int i, b;
+
+	json_arr(j, "streams");
+	for (i = 0; i < SEQ_STREAMS; i++) {
+		s = &streams[i];
+		if (!s->active)
+			continue;
+
+		seq_stream_done(s);
+		json_obj(j, NULL);
+		json_int(j, "stream", i);
+		json_uint(j, "received", s->rcv + s->late);
+		json_uint(j, "expected", s->rcv + s->lost);
+		json_uint(j, "lost", s->lost - s->late);
+		json_uint(j, "duplicated", s->dup);
+		json_uint(j, "reordered", s->reord);
+		json_uint(j, "reorder_extent_max", s->ext_max);
+		json_uint(j, "late", s->late);
+		json_uint(j, "loss_bursts", s->burst_num);
+		json_uint(j, "loss_burst_max", s->burst_max);
+
+		/* bin b holds bursts up to 2^b packets, last one - longer */
+		json_arr(j, "loss_burst_bins");
+		for (b = 0; b < SEQ_BURST_BINS; b++)
+			json_uint(j, NULL, s->burst_bin[b]);
+		json_end(j);
+
+		json_end(j);
+	}
+	json_end(j);
+}
+
+static void seq_metric(FILE *f, const char *name, const char *help, int off)
+{
+	int i;
+
+	metrics_family(f, name, "counter", help);
+	for (i = 0; i < SEQ_STREAMS; i++) {
+		if (!__atomic_load_n(&streams[i].active, __ATOMIC_RELAXED))
+			continue;
+
+		fprintf(f, "%s_total{stream=\"%d\"} %llu\n", name, i,
+			__atomic_load_n((__u64 *)((char *)&streams[i] + off),
+					__ATOMIC_RELAXED));
+	}
+}
+
+/* counters only, read while receiving, lost is known once out of window */
+void seq_metrics(FILE *f)
+{
+	seq_metric(f, "plget_seq_received", "unique packets received in window",
+		   offsetof(struct seq_stream, rcv));
+	seq_metric(f, "plget_seq_lost", "packets not received in window",
+		   offsetof(struct seq_stream, lost));
+	seq_metric(f, "plget_seq_late", "packets received out of window",
+		   offsetof(struct seq_stream, late));
+	seq_metric(f, "plget_seq_duplicated", "duplicated packets",
+		   offsetof(struct seq_stream, dup));
+	seq_metric(f, "plget_seq_reordered", "reordered packets",
+		   offsetof(struct seq_stream, reord));
+}
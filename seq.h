@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef PLGET_SEQ_H
+#define PLGET_SEQ_H
+
+#include <stdio.h>
+#include <linux/types.h>
+#include "json.h"
+
+#define SEQ_STREAMS		4	/* PTP stream id is 2 bits */
+#define SEQ_WIN			4096	/* tids tracked for dup and reorder */
+#define SEQ_BURST_BINS		12	/* loss bursts: 1, 2, 3-4, ... >1024 */
+
+/* RFC 4737 like sequence metrics of one stream, keyed by tid */
+struct seq_stream {
+	int active;
+	__u32 next;		/* next expected tid, NextExp of RFC 4737 */
+	__u32 tail;		/* oldest tid in window */
+	__u64 rcv;		/* unique received */
+	__u64 dup;
+	__u64 reord;		/* arrived with tid less than NextExp */
+	__u32 ext_max;		/* max reordering extent, in arrivals */
+	__u64 late;		/* older than window, counted as lost */
+	__u64 lost;
+	__u64 burst;		/* length of current loss burst */
+	__u64 burst_num;
+	__u64 burst_max;
+	__u64 burst_bin[SEQ_BURST_BINS];
+	__u32 seen[SEQ_WIN];	/* tid + 1 if received, keyed by tid */
+	__u32 arr[SEQ_WIN];	/* last tids in arrival order */
+	__u64 arr_num;
+};
+
+void seq_init(__u32 num);
+void seq_rx(int stream, __u32 tid);
+void seq_print(FILE *f);
+void seq_json(struct json *j);
+void seq_metrics(FILE *f);
+
+#endif
@@ -18,6 +18,10 @@
 #include "plget.h"
 #include <math.h>
 #include <string.h>
+#include <errno.h>
+#include "vect.h"
+#include "fmt.h"
+#include "store.h"
 
 #define LOG_ENTRY_SIZE		15
 #define LOG_BASE		8
@@ -46,186 +50,518 @@ static inline __u64 stat_num(struct stats *ss)
 	return ss->next_ts - ss->start_ts;
 }
 
-static inline __u64 to_num(struct stats *ss, struct timespec *ts)
+static inline __u64 to_num(struct stats *ss, __s64 *ts)
 {
 	return ts - ss->start_ts;
 }
 
-static inline __u64 to_val(struct timespec *ts)
+static inline __s64 to_ns(struct timespec *ts)
 {
-	return NSEC_PER_SEC * ts->tv_sec + ts->tv_nsec;
+	return (__s64)NSEC_PER_SEC * ts->tv_sec + ts->tv_nsec;
 }
 
-void stats_push(struct stats *ss, struct timespec *ts)
+/* ts with given id if it's present */
+static __s64 *stats_id_ts(struct stats *ss, __u32 id)
 {
-	ss->next_ts->tv_sec = ts->tv_sec;
-	ss->next_ts->tv_nsec = ts->tv_nsec;
-	ss->next_ts++;
+	int i = id & ss->win_mask;
+
+	if (!ss->ids) {
+		if (id >= ss->size || !ss->start_ts[id])
+			return NULL;
+
+		return ss->start_ts + id;
+	}
+
+	if (ss->ids[i] != id || !ss->start_ts[i])
+		return NULL;
+
+	return ss->start_ts + i;
 }
 
-void stats_push_id(struct stats *ss, struct timespec *ts, __u32 id)
+/* Welford's online mean and variance */
+static void stats_acc_add(struct stats_acc *acc, __s64 val)
+{
+	double delta;
+
+	if (!acc->n++) {
+		acc->min = val;
+		acc->max = val;
+	} else if (val < acc->min) {
+		acc->min = val;
+	} else if (val > acc->max) {
+		acc->max = val;
+	}
+
+	delta = val - acc->mean;
+	acc->mean += delta / acc->n;
+	acc->m2 += delta * (val - acc->mean);
+}
+
+double stats_acc_dev(struct stats_acc *acc)
+{
+	return acc->n ? sqrt(acc->m2 / acc->n) : 0;
+}
+
+static void stats_link_feed(struct stats_link *l, struct stats *ss,
+			    __s64 ts, __u32 id)
 {
-	if (id == ss->id) {
-		ss->next_ts->tv_sec = ts->tv_sec;
-		ss->next_ts->tv_nsec = ts->tv_nsec;
-		ss->next_ts++;
-		ss->id++;
+	__s64 *pts, val;
+	int idx;
+
+	pts = stats_id_ts(l->a == ss ? l->b : l->a, id);
+	if (!pts)
+		return;
+
+	val = l->a == ss ? ts - *pts : *pts - ts;
+
+	/* single writer, readers retry on odd or changed seq */
+	__atomic_store_n(&l->acc_seq, l->acc_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	stats_acc_add(&l->acc, val);
+	__atomic_store_n(&l->acc_seq, l->acc_seq + 1, __ATOMIC_RELEASE);
+
+	if (l->hist)
+		hist_add(l->hist, val);
+
+	if (!l->ivl[0])
 		return;
+
+	/* odd before idx is read, so swap can wait for it to leave old one */
+	__atomic_store_n(&l->ivl_seq, l->ivl_seq + 1, __ATOMIC_SEQ_CST);
+	idx = __atomic_load_n(&l->ivl_idx, __ATOMIC_SEQ_CST);
+	hist_add(l->ivl[idx], val);
+	__atomic_store_n(&l->ivl_seq, l->ivl_seq + 1, __ATOMIC_RELEASE);
+}
+
+static void stats_conf_add(struct stats_conf *c, __s64 gap)
+{
+	__s64 err = gap - c->period;
+	__s64 bin;
+
+	c->n++;
+	if (err > c->tol || err < -c->tol)
+		c->out++;
+
+	/* floor of err / tol, bins are centered on 0 */
+	bin = (err >= 0 ? err / c->tol : (err + 1) / c->tol - 1) +
+	      STATS_CONF_BINS / 2;
+	if (bin < 0)
+		bin = 0;
+	else if (bin >= STATS_CONF_BINS)
+		bin = STATS_CONF_BINS - 1;
+
+	c->bin[bin]++;
+
+	if (2 * gap < c->period) {
+		c->bunch++;
+		if (++c->run > c->run_max)
+			c->run_max = c->run;
+	} else {
+		c->run = 0;
+	}
+
+	if (2 * gap >= 3 * c->period) {
+		c->missed += (gap + c->period / 2) / c->period - 1;
+		c->miss_gaps++;
+	}
+}
+
+static void stats_gap_feed(struct stats *ss, __s64 ts, __u32 id)
+{
+	__s64 *pts;
+
+	pts = stats_id_ts(ss, id - 1);
+	if (pts) {
+		hist_add(ss->gap, ts - *pts);
+		if (ss->conf)
+			stats_conf_add(ss->conf, ts - *pts);
+	}
+
+	/* reordered, next one is already here */
+	pts = stats_id_ts(ss, id + 1);
+	if (pts) {
+		hist_add(ss->gap, *pts - ts);
+		if (ss->conf)
+			stats_conf_add(ss->conf, *pts - ts);
 	}
+}
+
+/* update everything computed on the fly once ts is stored */
+static void stats_feed(struct stats *ss, __s64 ts, __u32 id)
+{
+	int i;
+
+	if (!ts)
+		return;
+
+	if (ss->gap)
+		stats_gap_feed(ss, ts, id);
+
+	for (i = 0; i < ss->link_num; i++)
+		stats_link_feed(ss->links[i], ss, ts, id);
+}
+
+/*
+ * histogram backend, keep only window of ts to match latencies, ts of
+ * id out of range, duplicate id or id already out of window is rejected.
+ * Ids are compared as serial numbers, so they can wrap in continuous mode.
+ */
+static int stats_store_win(struct stats *ss, __s64 ts, __u32 id)
+{
+	int i = id & ss->win_mask;
+
+	if (ss->size && id >= ss->size)
+		return -1;
+
+	if (ss->ids[i] == id && ss->start_ts[i])
+		return -1;
+
+	if ((__s32)(ss->id - id) > (__s32)ss->win_mask)
+		return -1;
+
+	ss->ids[i] = id;
+	ss->start_ts[i] = ts;
+	if ((__s32)(id - ss->id) >= 0)
+		ss->id = id + 1;
 
-	if (id > ss->id) {
+	return 0;
+}
+
+/*
+ * raw backend, ts is stored in place of its id, so reordered ones are put
+ * in order and lost ones leave holes, id out of vector or duplicate one
+ * is rejected
+ */
+static int stats_store_raw(struct stats *ss, __s64 ts, __u32 id)
+{
+	if (id >= ss->size || ss->start_ts[id])
+		return -1;
+
+	ss->start_ts[id] = ts;
+	if (id >= ss->id) {
 		ss->id = id + 1;
-		ss->next_ts += id - ss->id + 1;
+		ss->next_ts = ss->start_ts + ss->id;
+	}
+
+	return 0;
+}
+
+void stats_push_ns(struct stats *ss, __s64 ts, __u32 id)
+{
+	int ret;
+
+	if (!ts)
+		return;
+
+	ret = ss->ids ? stats_store_win(ss, ts, id) :
+			stats_store_raw(ss, ts, id);
+	if (ret) {
+		ss->rej++;
+		return;
+	}
+
+	if (!ss->cnt++) {
+		ss->first = ts;
+		ss->last = ts;
+	} else if (ts < ss->first) {
+		ss->first = ts;
+	} else if (ts > ss->last) {
+		ss->last = ts;
 	}
 
-	(ss->start_ts + id)->tv_sec = ts->tv_sec;
-	(ss->start_ts + id)->tv_nsec = ts->tv_nsec;
+	stats_feed(ss, ts, id);
+}
+
+void stats_push(struct stats *ss, struct timespec *ts)
+{
+	stats_push_ns(ss, to_ns(ts), ss->id);
+}
+
+void stats_push_id(struct stats *ss, struct timespec *ts, __u32 id)
+{
+	stats_push_ns(ss, to_ns(ts), id);
 }
 
 int stats_correct_id(struct stats *ss, __u32 id)
 {
-	return ts_correct(ss->start_ts + id);
+	return !!stats_id_ts(ss, id);
 }
 
-static double stats_mean(struct stats *ss)
+/* ts of given id in ns, 0 if it's absent or out of window already */
+__s64 stats_id_ns(struct stats *ss, __u32 id)
 {
-	struct timespec *ts;
-	double mean = 0;
-	__u64 val;
-	__u64 n;
+	__s64 *pts = stats_id_ts(ss, id);
 
-	n = stat_num(ss);
-	for (ts = ss->start_ts; ts < ss->next_ts; ts++) {
-		val = to_val(ts);
-		mean += val / (n * 1000.0);
-	}
+	return pts ? *pts : 0;
+}
 
-	return mean;
+__s64 stats_first(struct stats *ss)
+{
+	return ss->cnt ? ss->first : 0;
 }
 
-static double stats_gap_mean(struct stats *ss)
+/* res = a - b for ts present in both, 0 as lost ts for others */
+void stats_diff(struct stats *a, struct stats *b, struct stats *res)
 {
-	struct timespec *ts, temp;
-	double mean = 0;
-	__u64 n;
+	__u64 n, an, bn;
 
-	n = stat_num(ss);
-	for (ts = ss->start_ts + 1; ts < ss->next_ts; ts++) {
-		ts_sub(ts, ts - 1, &temp);
-		mean += to_val(&temp) / ((n - 1) * 1000.0);
+	an = stat_num(a);
+	bn = stat_num(b);
+	n = an < bn ? an : bn;
+
+	res->cnt = vect_diff(a->start_ts, b->start_ts, res->start_ts, n);
+	res->next_ts = res->start_ts + n;
+}
+
+/*
+ * values to get statistic from: present ts or gaps between ts of adjacent
+ * ids, lost ones and gaps around them are skipped. Returns number of values.
+ */
+static __u64 stats_values(struct stats *ss, int flags, __s64 *v)
+{
+	__s64 *ts = ss->start_ts;
+	__u64 i, n = 0;
+
+	if (!(flags & STATS_GAP_DATA)) {
+		for (i = 0; i < stat_num(ss); i++) {
+			if (ts[i])
+				v[n++] = ts[i];
+		}
+
+		return n;
 	}
 
-	return mean;
+	for (i = 1; i < stat_num(ss); i++) {
+		if (ts[i] && ts[i - 1])
+			v[n++] = ts[i] - ts[i - 1];
+	}
+
+	return n;
+}
+
+/* percentiles to report, sorted ascending */
+static double stats_pct[STATS_PCT_MAX] = {50, 90, 99, 99.9, 99.99, 99.999};
+static int stats_pct_num = 6;
+
+static int stats_pct_cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
 }
 
-static double stats_gap_dev(struct stats *ss, double mean)
+int stats_set_pct(double *pct, int num)
 {
-	struct timespec *ts, temp;
-	double dev = 0;
-	double mdif;
-	__u64 n;
+	int i;
 
-	n = stat_num(ss);
-	for (ts = ss->start_ts + 1; ts < ss->next_ts; ts++) {
-		ts_sub(ts, ts - 1, &temp);
-		mdif = mean - to_val(&temp) / 1000.0;
-		mdif *= mdif;
-		dev += mdif / (n - 1);
+	if (num < 1 || num > STATS_PCT_MAX)
+		return -1;
+
+	for (i = 0; i < num; i++) {
+		if (pct[i] <= 0 || pct[i] > 100)
+			return -1;
+
+		stats_pct[i] = pct[i];
 	}
 
-	dev = sqrt(dev);
-	return dev;
+	stats_pct_num = num;
+	qsort(stats_pct, num, sizeof(*stats_pct), stats_pct_cmp);
+	return 0;
 }
 
-static double stats_dev(struct stats *ss, double mean)
+/* percentiles being reported, returns number of them */
+int stats_get_pct(double *pct)
 {
-	struct timespec *ts;
-	double dev = 0;
-	double mdif;
-	__u64 n;
+	memcpy(pct, stats_pct, stats_pct_num * sizeof(*pct));
+	return stats_pct_num;
+}
 
-	n = stat_num(ss);
-	for (ts = ss->start_ts; ts < ss->next_ts; ts++) {
-		mdif = mean - to_val(ts) / 1000.0;
-		mdif *= mdif;
-		dev += mdif / n;
+/* rank of percentile, same as used by histogram, 1 based */
+static __u64 stats_pct_rank(double pct, __u64 n)
+{
+	__u64 rank = ceil(pct * n / 100);
+
+	if (!rank)
+		return 1;
+
+	return rank > n ? n : rank;
+}
+
+static void stats_swap(__s64 *a, __s64 *b)
+{
+	__s64 t = *a;
+
+	*a = *b;
+	*b = t;
+}
+
+/*
+ * Hoare's selection, v[k] is in its sorted place after it, all before are
+ * not greater and all after are not less than it, so next percentile can
+ * be selected starting from k. Median of 3 keeps it linear on sorted data.
+ */
+static __s64 stats_select(__s64 *v, __u64 lo, __u64 hi, __u64 k)
+{
+	__u64 i, j, mid;
+	__s64 pivot;
+
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (v[mid] < v[lo])
+			stats_swap(&v[mid], &v[lo]);
+		if (v[hi] < v[lo])
+			stats_swap(&v[hi], &v[lo]);
+		if (v[hi] < v[mid])
+			stats_swap(&v[hi], &v[mid]);
+
+		pivot = v[mid];
+		i = lo;
+		j = hi;
+		for (;;) {
+			while (v[++i] < pivot)
+				;
+			while (v[--j] > pivot)
+				;
+			if (i >= j)
+				break;
+
+			stats_swap(&v[i], &v[j]);
+		}
+
+		/* v[hi] >= pivot and v[lo] <= pivot are sentinels */
+		if (k <= j)
+			hi = j;
+		else
+			lo = j + 1;
 	}
 
-	dev = sqrt(dev);
-	return dev;
+	if (hi > lo && v[hi] < v[lo])
+		stats_swap(&v[hi], &v[lo]);
+
+	return v[k];
 }
 
-void stats_diff(struct stats *a, struct stats *b, struct stats *res)
+static void stats_pct_line(FILE *f, __s64 *val)
 {
-	struct timespec *tsa, *tsb;
+	int i;
 
-	tsa = a->start_ts;
-	tsb = b->start_ts;
-	res->next_ts = res->start_ts;
+	for (i = 0; i < stats_pct_num; i++)
+		fprintf(f, "%sp%g = %.2fus", i ? ", " : "", stats_pct[i],
+		       val[i] / 1000.0);
 
-	while (tsa < a->next_ts && tsb < b->next_ts) {
-		if (ts_correct(tsa) && ts_correct(tsb)) {
-			ts_sub(tsa++, tsb++, res->next_ts++);
-		} else
-			break;
+	fprintf(f, "\n");
+}
+
+/* percentiles of values to val, order of v is changed */
+static void stats_pct_print(FILE *f, __s64 *v, __u64 n, __s64 *val)
+{
+	__u64 i, k, lo = 0;
+
+	for (i = 0; i < stats_pct_num; i++) {
+		k = stats_pct_rank(stats_pct[i], n) - 1;
+		val[i] = stats_select(v, lo, n - 1, k);
+		lo = k;
 	}
+
+	stats_pct_line(f, val);
 }
 
-static void stats_print_log(struct stats *ss, int flags, struct timespec *rtime)
+static void stats_sum_fill(struct stats_sum *sum, __u64 n, __s64 min,
+			   __s64 max, double mean, double dev, __s64 *val)
+{
+	int i;
+
+	sum->n = n;
+	sum->min = min;
+	sum->max = max;
+	sum->mean = mean;
+	sum->dev = dev;
+	sum->pct_num = stats_pct_num;
+	for (i = 0; i < stats_pct_num; i++) {
+		sum->pct[i] = stats_pct[i];
+		sum->val[i] = val[i];
+	}
+}
+
+/* w/o fmt buffer, if it couldn't be allocated, printf is used instead */
+static void stats_log_str(FILE *f, struct fmt_buf *b, const char *str)
+{
+	if (b)
+		fmt_str(b, str, strlen(str));
+	else
+		fputs(str, f);
+}
+
+static void stats_log_g(FILE *f, struct fmt_buf *b, __s64 ns, int width)
+{
+	if (b)
+		fmt_g(b, ns, width);
+	else
+		fprintf(f, "%*g", width, ns / 1000.0);
+}
+
+static void stats_print_log(FILE *f, struct stats *ss, int flags,
+			    __s64 *rtime)
 {
 	double min_val = 1000000, max_val = 0;
-	struct timespec *ts, temp;
 	char line[LOG_LINE_SIZE];
 	int max_n = 0, min_n = 0;
-	__u64 n, start;
+	struct fmt_buf *b;
+	int pad, absent;
+	__s64 *ts, ns;
 	double val;
-	int pad;
+	__u64 n;
 
 	if (flags & STATS_LIN_DATA) {
-		start = to_val(rtime);
-		printf("relative abs time %llu ns\n", start);
-		start = to_val(ss->start_ts);
-		printf("first packet abs time %llu ns\n", start);
+		fprintf(f, "relative abs time %llu ns\n", *rtime);
+		fprintf(f, "first packet abs time %llu ns\n", stats_first(ss));
 	}
 
 	memset(line, '-', LOG_LINE_SIZE - 1);
 	line[LOG_LINE_SIZE - 1] = 0;
-	printf("%s", line);
+	fprintf(f, "%s", line);
 
 	if (flags & STATS_PLAIN_OUTPUT)
-		printf("\n");
+		fprintf(f, "\n");
+
+	/* values are the most of output, they are formatted w/o printf */
+	b = malloc(sizeof(*b));
+	if (b)
+		fmt_init(b, f);
 
 	n = stat_num(ss);
 	for (ts = ss->start_ts; ts < ss->next_ts; ts++) {
-		if (flags & STATS_LIN_DATA) {
-			ts_sub(ts, rtime, &temp);
-			val = to_val(&temp) / 1000.0;
-		} else if (flags & STATS_GAP_DATA) {
-			if (!to_num(ss, ts)) {
-				val = 0;
-			} else {
-				ts_sub(ts, ts - 1, &temp);
-				val = to_val(&temp) / 1000.0;
-			}
-		} else {
-			val = to_val(ts) / 1000.0;
-		}
+		/* lost ts are printed as 0 */
+		absent = !*ts;
+		if (flags & STATS_GAP_DATA)
+			absent |= !to_num(ss, ts) || !ts[-1];
+
+		if (absent)
+			ns = 0;
+		else if (flags & STATS_LIN_DATA)
+			ns = *ts - *rtime;
+		else if (flags & STATS_GAP_DATA)
+			ns = ts[0] - ts[-1];
+		else
+			ns = *ts;
 
-		if (flags & STATS_PLAIN_OUTPUT)
-			printf("%g\n", val);
-		else {
+		val = ns / 1000.0;
+		if (flags & STATS_PLAIN_OUTPUT) {
+			stats_log_g(f, b, ns, 0);
+			stats_log_str(f, b, "\n");
+		} else {
 			if (!(to_num(ss, ts) % LOG_BASE))
-				printf("\n");
+				stats_log_str(f, b, "\n");
 
-			printf(" %*g |", LOG_ENTRY_SIZE - 3, val);
+			stats_log_str(f, b, " ");
+			stats_log_g(f, b, ns, LOG_ENTRY_SIZE - 3);
+			stats_log_str(f, b, " |");
 		}
 
-		if (flags & STATS_GAP_DATA) {
-			if (!to_num(ss, ts)) {
-				if (n == 1)
-					min_val = 0;
-				continue;
-			}
+		if (absent) {
+			if (n == 1)
+				min_val = 0;
+			continue;
 		}
 
 		if (max_val < val) {
@@ -239,43 +575,213 @@ static void stats_print_log(struct stats *ss, int flags, struct timespec *rtime)
 		}
 	}
 
+	if (b)
+		fmt_flush(b);
+	free(b);
+
 	int pad_needed = !(flags & STATS_PLAIN_OUTPUT) &&
 			 (to_num(ss, ts) % LOG_BASE);
 	if (pad_needed) {
 		pad = (LOG_BASE - to_num(ss, ts) % LOG_BASE) * LOG_ENTRY_SIZE;
-		printf("%*c", pad, '|');
+		fprintf(f, "%*c", pad, '|');
 	}
 
-	printf("\n%s\n", line);
+	fprintf(f, "\n%s\n", line);
 
 	if (flags & STATS_LIN_DATA)
 		return;
 
-	printf("max val(#%d) = %.2fus\n", max_n, max_val);
-	printf("min val(#%d) = %.2fus\n", min_n, min_val);
-	printf("peak-to-peak = %.2fus\n", max_val - min_val);
+	fprintf(f, "max val(#%d) = %.2fus\n", max_n, max_val);
+	fprintf(f, "min val(#%d) = %.2fus\n", min_n, min_val);
+	fprintf(f, "peak-to-peak = %.2fus\n", max_val - min_val);
+}
+
+/* use ts memory allocated by caller */
+void stats_reserve_buf(struct stats *ss, __s64 *ts, int entry_num)
+{
+	ss->start_ts = ts;
+	ss->next_ts = ts;
+	ss->size = entry_num;
 }
 
 int stats_reserve(struct stats *ss, int entry_num)
 {
-	struct timespec *ts;
+	__s64 *ts;
 
-	ts = malloc(entry_num * sizeof(*ts));
+	ts = calloc(entry_num, sizeof(*ts));
 	if (ts == NULL)
 		return -1;
 
-	ss->start_ts = ts;
-	ss->next_ts = ts;
+	stats_reserve_buf(ss, ts, entry_num);
+	return 0;
+}
+
+/*
+ * stats_reserve_hist - reserve window of win (power of 2) ts only, that's
+ * enough to match latencies of reordered packets on the fly
+ * @entry_num - ids are expected to be less, 0 if not limited
+ * @gap_digits - precision of interpacket gap histogram, 0 if not needed
+ */
+int stats_reserve_hist(struct stats *ss, int entry_num, int win,
+		       int gap_digits)
+{
+	ss->start_ts = calloc(win, sizeof(*ss->start_ts));
+	ss->ids = calloc(win, sizeof(*ss->ids));
+	if (!ss->start_ts || !ss->ids)
+		return -1;
+
+	ss->next_ts = ss->start_ts;
+	ss->win_mask = win - 1;
+	ss->size = entry_num;
+
+	if (!gap_digits)
+		return 0;
+
+	ss->gap = malloc(sizeof(*ss->gap));
+	if (!ss->gap)
+		return -1;
+
+	return hist_init(ss->gap, gap_digits);
+}
 
+/*
+ * stats_link_init - a - b latency, updated on the fly each time both ts
+ * with same id are present, histogram is fed also if digits is not 0
+ */
+int stats_link_init(struct stats_link *l, char *name, struct stats *a,
+		    struct stats *b, int digits)
+{
+	l->name = name;
+	l->a = a;
+	l->b = b;
+
+	if (a->link_num >= STATS_LINKS_MAX || b->link_num >= STATS_LINKS_MAX)
+		return -1;
+
+	a->links[a->link_num++] = l;
+	b->links[b->link_num++] = l;
+
+	if (!digits)
+		return 0;
+
+	l->hist = malloc(sizeof(*l->hist));
+	if (!l->hist)
+		return -1;
+
+	return hist_init(l->hist, digits);
+}
+
+/*
+ * stats_conf_init - check gaps against expected period, with histogram
+ * backend gaps are added on the fly, with raw ts - once printed
+ * @tol - tolerance, gap error within +-tol is conforming
+ */
+int stats_conf_init(struct stats *ss, __s64 period, __s64 tol)
+{
+	ss->conf = calloc(1, sizeof(*ss->conf));
+	if (!ss->conf)
+		return -1;
+
+	ss->conf->period = period;
+	ss->conf->tol = tol;
 	return 0;
 }
 
+/* gap error histogram, out of tolerance, bunched and missed slots */
+void stats_conf_print(FILE *f, struct stats *ss)
+{
+	struct stats_conf *c = ss->conf;
+	__s64 *ts = ss->start_ts;
+	double lo, hi, pct;
+	__u64 i;
+	int b;
+
+	if (!ss->ids) {
+		for (i = 1; i < stat_num(ss); i++) {
+			if (ts[i] && ts[i - 1])
+				stats_conf_add(c, ts[i] - ts[i - 1]);
+		}
+	}
+
+	if (!c->n)
+		return;
+
+	fprintf(f, "gap conformance to %.2fus period, tolerance +- %.2fus\n",
+		c->period / 1000.0, c->tol / 1000.0);
+
+	for (b = 0; b < STATS_CONF_BINS; b++) {
+		lo = (b - STATS_CONF_BINS / 2) * c->tol / 1000.0;
+		hi = lo + c->tol / 1000.0;
+		pct = 100.0 * c->bin[b] / c->n;
+
+		if (!b)
+			fprintf(f, "error < %.2fus", hi);
+		else if (b == STATS_CONF_BINS - 1)
+			fprintf(f, "error >= %.2fus", lo);
+		else
+			fprintf(f, "error [%.2f, %.2f)us", lo, hi);
+
+		fprintf(f, ": %llu (%.2f%%)\n", c->bin[b], pct);
+	}
+
+	fprintf(f, "out of tolerance: %llu of %llu (%.2f%%)\n", c->out, c->n,
+		100.0 * c->out / c->n);
+	fprintf(f, "bunched (< period / 2): %llu, longest back-to-back run: "
+		"%llu packets\n", c->bunch, c->run_max ? c->run_max + 1 : 0);
+	fprintf(f, "missed slots: %llu in %llu gaps\n\n", c->missed,
+		c->miss_gaps);
+}
+
+/*
+ * stats_burst_print - time from first to last packet of each burst of
+ * burst back-to-back ones, only bursts with all ts present are counted
+ */
+void stats_burst_print(FILE *f, struct stats *ss, int burst)
+{
+	__s64 ts, d, lo = 0, hi = 0, min = 0, max = 0;
+	double sum = 0;
+	__u64 n = 0;
+	__u32 id;
+	int i;
+
+	for (id = 0; id + burst <= ss->id; id += burst) {
+		for (i = 0; i < burst; i++) {
+			ts = stats_id_ns(ss, id + i);
+			if (!ts)
+				break;
+
+			if (!i || ts < lo)
+				lo = ts;
+			if (!i || ts > hi)
+				hi = ts;
+		}
+
+		if (i < burst)
+			continue;
+
+		d = hi - lo;
+		if (!n++ || d < min)
+			min = d;
+		if (d > max)
+			max = d;
+		sum += d;
+	}
+
+	if (!n)
+		return;
+
+	fprintf(f, "burst spread, first to last of %d packets: %llu bursts, "
+		"min %.3fus, mean %.3fus, max %.3fus, mean gap in burst "
+		"%.3fus\n\n", burst, n, min / 1000.0, sum / n / 1000.0,
+		max / 1000.0, sum / n / (burst - 1) / 1000.0);
+}
+
 void stats_drate_print(struct timespec *interval, int pkt_num, int data_size)
 {
 	__u64 val;
 	double rate, pps, period;
 
-	val = to_val(interval);
+	val = to_ns(interval);
 	pps = (double)pkt_num * NSEC_PER_SEC / val;
 	rate = (double)data_size * 8 * USEC_PER_SEC / val;
 	period = val / (double)pkt_num;
@@ -296,45 +802,250 @@ void stats_vrate_print(struct stats *ss, int frame_size)
 {
 	struct timespec interval;
 	unsigned int pkt_num;
+	__s64 ns;
+
+	pkt_num = ss->cnt;
+	ns = ss->last - ss->first;
 
-	pkt_num = ss->next_ts - ss->start_ts;
-	if (pkt_num-- < 2 || !ts_correct(ss->start_ts))
+	if (pkt_num-- < 2)
 		return;
 
-	ts_sub(ss->next_ts - 1, ss->start_ts, &interval);
+	interval.tv_sec = ns / NSEC_PER_SEC;
+	interval.tv_nsec = ns % NSEC_PER_SEC;
 	stats_rate_print(&interval, pkt_num, frame_size);
 }
 
-int stats_print(char *str, struct stats *ss, int flags, struct timespec *rtime)
+static int stats_print_acc(FILE *f, char *str, struct stats *ss, int flags,
+			   __s64 *rtime, struct stats_acc *acc,
+			   struct stats_sum *sum)
 {
+	__s64 val[STATS_PCT_MAX];
+	__s64 min, max;
 	double mean, dev;
-	__u64 n;
+	__u64 i, n;
+	__s64 *v;
 
-	/* don't print if first entry is incorrect or no entries */
-	n = stat_num(ss);
-	if (!n || !ts_correct(ss->start_ts))
+	/* don't print if no entries */
+	if (!ss->cnt)
 		return 0;
 
-	printf("%s: packets %llu:\n", str, n);
+	fprintf(f, "%s: packets %llu:\n", str, ss->cnt);
 
 	if (rtime)
 		flags |= STATS_LIN_DATA;
 
-	stats_print_log(ss, flags, rtime);
+	stats_print_log(f, ss, flags, rtime);
 
 	if (flags & STATS_LIN_DATA)
 		goto out;
 
-	if (flags & STATS_GAP_DATA) {
-		mean = stats_gap_mean(ss);
-		dev = stats_gap_dev(ss, mean);
+	v = store_scratch(stat_num(ss));
+	if (!v) {
+		fprintf(f, "no memory for percentiles: %s\n",
+			strerror(errno));
+		goto out;
+	}
+
+	n = stats_values(ss, flags, v);
+	if (!n)
+		goto free;
+
+	if (acc && acc->n) {
+		/* already computed on the fly */
+		mean = acc->mean;
+		dev = stats_acc_dev(acc);
 	} else {
-		mean = stats_mean(ss);
-		dev = stats_dev(ss, mean);
+		mean = (double)vect_sum(v, n) / n;
+		dev = sqrt(vect_sqdev(v, n, mean) / n);
+	}
+
+	if (sum) {
+		for (i = 1, min = max = v[0]; i < n; i++) {
+			if (v[i] < min)
+				min = v[i];
+			else if (v[i] > max)
+				max = v[i];
+		}
 	}
 
-	printf("mean +- RMS = %.2f +- %.2f us\n", mean, dev);
+	stats_pct_print(f, v, n, val);
+	fprintf(f, "mean +- RMS = %.2f +- %.2f us\n", mean / 1000.0, dev / 1000.0);
+
+	if (sum)
+		stats_sum_fill(sum, n, min, max, mean, dev, val);
+free:
+	store_scratch_free(v);
 out:
-	printf("\n");
-	return n;
+	fprintf(f, "\n");
+	return ss->cnt;
+}
+
+int stats_print(FILE *f, char *str, struct stats *ss, int flags,
+		__s64 *rtime, struct stats_sum *sum)
+{
+	return stats_print_acc(f, str, ss, flags, rtime, NULL, sum);
+}
+
+static int stats_hist_print_acc(FILE *f, char *str, struct hist *h,
+				struct stats_acc *acc, struct stats_sum *sum)
+{
+	__s64 val[STATS_PCT_MAX];
+	double min, max, mean, dev;
+	int i;
+
+	if (!h || !h->n)
+		return 0;
+
+	fprintf(f, "%s: packets %llu:\n", str, h->n);
+
+	min = h->min / 1000.0;
+	max = h->max / 1000.0;
+	fprintf(f, "max val = %.2fus\n", max);
+	fprintf(f, "min val = %.2fus\n", min);
+	fprintf(f, "peak-to-peak = %.2fus\n", max - min);
+
+	for (i = 0; i < stats_pct_num; i++)
+		val[i] = hist_percentile(h, stats_pct[i]);
+
+	stats_pct_line(f, val);
+
+	if (h->neg)
+		fprintf(f, "negative values: %llu\n", h->neg);
+
+	if (acc) {
+		mean = acc->mean;
+		dev = stats_acc_dev(acc);
+	} else {
+		mean = hist_mean(h);
+		dev = hist_dev(h);
+	}
+
+	fprintf(f, "mean +- RMS = %.2f +- %.2f us\n", mean / 1000.0, dev / 1000.0);
+	fprintf(f, "\n");
+
+	if (sum) {
+		stats_sum_fill(sum, h->n, h->min, h->max, mean, dev, val);
+		sum->neg = h->neg;
+	}
+
+	return h->n;
+}
+
+int stats_hist_print(FILE *f, char *str, struct hist *h,
+		     struct stats_sum *sum)
+{
+	return stats_hist_print_acc(f, str, h, NULL, sum);
+}
+
+/*
+ * stats_link_print - print a - b latency, raw ts are diffed to tmp to get
+ * printout, while mean and RMS are taken from online accumulator
+ */
+int stats_link_print(FILE *f, char *str, struct stats_link *l,
+		     struct stats *tmp, int flags, struct stats_sum *sum)
+{
+	if (l->hist)
+		return stats_hist_print_acc(f, str, l->hist, &l->acc, sum);
+
+	stats_diff(l->a, l->b, tmp);
+	return stats_print_acc(f, str, tmp, flags, NULL, &l->acc, sum);
+}
+
+/* consistent copy of the link accumulator, w/o blocking its writer */
+void stats_link_snap(struct stats_link *l, struct stats_acc *acc)
+{
+	__u32 seq;
+
+	for (;;) {
+		seq = __atomic_load_n(&l->acc_seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+
+		memcpy(acc, &l->acc, sizeof(*acc));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&l->acc_seq, __ATOMIC_RELAXED) == seq)
+			break;
+	}
+}
+
+/* short summary of the link computed so far, can be used while running */
+void stats_link_summary(struct stats_link *l)
+{
+	struct stats_acc acc;
+
+	stats_link_snap(l, &acc);
+
+	if (!acc.n)
+		return;
+
+	printf("%-16s n = %llu, min = %.2fus, max = %.2fus, "
+	       "mean +- RMS = %.2f +- %.2f us\n", l->name, acc.n,
+	       acc.min / 1000.0, acc.max / 1000.0, acc.mean / 1000.0,
+	       stats_acc_dev(&acc) / 1000.0);
+}
+
+/*
+ * stats_link_ivl_init - per interval histograms, fed along with the rest,
+ * so interval summary can be printed while running with fixed memory
+ */
+int stats_link_ivl_init(struct stats_link *l, int digits)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		l->ivl[i] = malloc(sizeof(*l->ivl[i]));
+		if (!l->ivl[i] || hist_init(l->ivl[i], digits))
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * stats_link_ivl_swap - close the interval, the other histogram is fed
+ * since now. Returns once the writer is out of the closed one, so it can
+ * be printed and reset by stats_link_ivl_print() right after.
+ */
+void stats_link_ivl_swap(struct stats_link *l)
+{
+	/* a is later stage, ids passed it are expected, not ones in flight */
+	__u32 id = l->a->id;
+	__u32 seq;
+
+	l->ivl_exp = (__s32)(id - l->ivl_id);
+	l->ivl_id = id;
+
+	__atomic_store_n(&l->ivl_idx, !l->ivl_idx, __ATOMIC_SEQ_CST);
+
+	/* add in progress could have read old idx, any next one reads new */
+	seq = __atomic_load_n(&l->ivl_seq, __ATOMIC_SEQ_CST);
+	if (!(seq & 1))
+		return;
+
+	while (__atomic_load_n(&l->ivl_seq, __ATOMIC_ACQUIRE) == seq)
+		;
+}
+
+/* print closed interval as count, loss and min/p50/p99/max, then reset it */
+void stats_link_ivl_print(FILE *f, char *str, struct stats_link *l)
+{
+	struct hist *h = l->ivl[!l->ivl_idx];
+	__s64 loss;
+
+	if (!l->acc.n)
+		return;
+
+	loss = l->ivl_exp - (__s64)h->n;
+	if (loss < 0)
+		loss = 0;
+
+	fprintf(f, "%s%-16s n = %llu, loss = %lld", str, l->name, h->n, loss);
+	if (h->n)
+		fprintf(f, ", min = %.2fus, p50 = %.2fus, p99 = %.2fus, "
+			"max = %.2fus", h->min / 1000.0,
+			hist_percentile(h, 50) / 1000.0,
+			hist_percentile(h, 99) / 1000.0, h->max / 1000.0);
+
+	fprintf(f, "\n");
+	hist_reset(h);
 }
@@ -12,8 +12,10 @@
  * GNU General Public License for more details.
  */
 
+#include <stdio.h>
 #include <time.h>
 #include <linux/types.h>
+#include "hist.h"
 
 #define STATS_PLAIN_OUTPUT	0x01
 #define STATS_LIN_DATA		0x02
@@ -22,19 +24,117 @@
 #ifndef LAT_STAT_H
 #define LAT_STAT_H
 
+#define STATS_WIN		4096	/* ts window for histogram backend */
+#define STATS_LINKS_MAX		8
+#define STATS_PCT_MAX		16	/* max number of reported percentiles */
+#define STATS_CONF_BINS		10	/* gap error bins, tolerance wide */
+
+struct stats_link;
+
+/* online mean/RMS, Welford's method */
+struct stats_acc {
+	__u64 n;
+	double mean;
+	double m2;
+	__s64 min;
+	__s64 max;
+};
+
+/* conformance of gaps to expected period */
+struct stats_conf {
+	__s64 period;
+	__s64 tol;
+	__u64 n;
+	__u64 out;		/* out of tolerance */
+	__u64 bunch;		/* less than half of period, back-to-back */
+	__u64 run;		/* current run of bunched gaps */
+	__u64 run_max;
+	__u64 missed;		/* slots w/o packet, gap is 1.5 period or more */
+	__u64 miss_gaps;	/* gaps with missed slots */
+	__u64 bin[STATS_CONF_BINS];
+};
+
+/* numbers of a printed block, for machine readable output */
+struct stats_sum {
+	__u64 n;
+	__s64 min;
+	__s64 max;
+	double mean;
+	double dev;
+	__u64 neg;		/* negative values, histogram only */
+	int pct_num;
+	double pct[STATS_PCT_MAX];
+	__s64 val[STATS_PCT_MAX];
+};
+
+/* ts are packed in ns, 0 means absent ts */
 struct stats {
-	struct timespec *next_ts;
-	struct timespec *start_ts;
+	__s64 *next_ts;
+	__s64 *start_ts;
+	__u32 size;
 	__u32 id;
+
+	/* histogram backend, start_ts is a window of last ts keyed by id */
+	__u32 *ids;
+	__u32 win_mask;
+
+	__u64 cnt;		/* ts present */
+	__u64 rej;		/* ts rejected, bad or duplicate id */
+	__s64 first;
+	__s64 last;
+	struct hist *gap;
+	struct stats_conf *conf;
+	struct stats_link *links[STATS_LINKS_MAX];
+	int link_num;
+};
+
+/* a - b latency, fed on the fly, histogram - if the backend is used */
+struct stats_link {
+	char *name;
+	struct stats *a;
+	struct stats *b;
+	struct stats_acc acc;
+	__u32 acc_seq;		/* odd while acc is updated */
+	struct hist *hist;
+	struct hist *ivl[2];	/* interval hists, one is fed, other printed */
+	int ivl_idx;		/* one being fed */
+	__u32 ivl_seq;		/* odd while interval hist is fed */
+	__u32 ivl_id;		/* next a id by the end of last interval */
+	__s64 ivl_exp;		/* ids expected within last interval */
 };
 
 void ts_sub(struct timespec *a, struct timespec *b, struct timespec *res);
 void stats_push(struct stats *ss, struct timespec *ts);
 void stats_push_id(struct stats *ss, struct timespec *ts, __u32 id);
-int stats_print(char *str, struct stats *ss, int flags, struct timespec *rtime);
+void stats_push_ns(struct stats *ss, __s64 ts, __u32 id);
+int stats_print(FILE *f, char *str, struct stats *ss, int flags,
+		__s64 *rtime, struct stats_sum *sum);
 int stats_reserve(struct stats *ss, int entry_num);
+void stats_reserve_buf(struct stats *ss, __s64 *ts, int entry_num);
 void stats_diff(struct stats *a, struct stats *b, struct stats *res);
 int stats_correct_id(struct stats *ss, __u32 id);
+__s64 stats_id_ns(struct stats *ss, __u32 id);
+__s64 stats_first(struct stats *ss);
+
+int stats_reserve_hist(struct stats *ss, int entry_num, int win,
+		       int gap_digits);
+int stats_link_init(struct stats_link *l, char *name, struct stats *a,
+		    struct stats *b, int digits);
+int stats_link_print(FILE *f, char *str, struct stats_link *l,
+		     struct stats *tmp, int flags, struct stats_sum *sum);
+void stats_link_summary(struct stats_link *l);
+void stats_link_snap(struct stats_link *l, struct stats_acc *acc);
+int stats_link_ivl_init(struct stats_link *l, int digits);
+void stats_link_ivl_swap(struct stats_link *l);
+void stats_link_ivl_print(FILE *f, char *str, struct stats_link *l);
+double stats_acc_dev(struct stats_acc *acc);
+int stats_set_pct(double *pct, int num);
+int stats_get_pct(double *pct);
+int stats_conf_init(struct stats *ss, __s64 period, __s64 tol);
+void stats_conf_print(FILE *f, struct stats *ss);
+void stats_burst_print(FILE *f, struct stats *ss, int burst);
+int stats_hist_print(FILE *f, char *str, struct hist *h,
+		     struct stats_sum *sum);
 
 void stats_vrate_print(struct stats *ss, int frame_size);
 void stats_rate_print(struct timespec *interval, int pkt_num, int frame_size);
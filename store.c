@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "store.h"
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE	23
+#endif
+
+struct store_region {
+	char *base;
+	size_t len;
+	off_t off;
+	__s64 **pos;		/* current write position */
+	size_t done;		/* written back and dropped till */
+	size_t ahead;		/* faulted in till */
+};
+
+/* file range of a report scratch vector, reused once freed */
+struct store_scratch {
+	char *base;
+	size_t len;
+	off_t off;
+	int used;
+};
+
+static struct store_region regions[STORE_REGIONS_MAX];
+static int region_num;
+static size_t store_size;
+static int store_fd = -1;
+static struct store_scratch *scratch;
+static int scratch_num;
+static pthread_mutex_t scratch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int store_open(char *path)
+{
+	store_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (store_fd < 0)
+		return perror("open ts file"), -errno;
+
+	return 0;
+}
+
+/* fault pages in for write w/o touching data, it can be written already */
+static void store_populate(char *addr, size_t len)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	volatile char *p;
+
+	if (!madvise(addr, len, MADV_POPULATE_WRITE))
+		return;
+
+	/* old kernel, read fault at least */
+	for (p = addr; p < addr + len; p += page)
+		(void)*p;
+}
+
+static size_t store_ahead(struct store_region *r, size_t from)
+{
+	size_t end = from + STORE_AHEAD;
+
+	return end > r->len ? r->len : end;
+}
+
+/*
+ * store_map - map region for num ts, pos points on write position, the
+ * region is written back and dropped behind it while running
+ */
+__s64 *store_map(size_t num, __s64 **pos)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	struct store_region *r;
+	size_t len;
+	int ret;
+
+	if (store_fd < 0 || region_num == STORE_REGIONS_MAX)
+		return NULL;
+
+	len = (num * sizeof(__s64) + page - 1) & ~(page - 1);
+	r = &regions[region_num];
+
+	/* allocate blocks now, not on first write */
+	ret = posix_fallocate(store_fd, store_size, len);
+	if (ret) {
+		errno = ret;
+		perror("fallocate ts file");
+		return NULL;
+	}
+
+	r->base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED,
+		       store_fd, store_size);
+	if (r->base == MAP_FAILED) {
+		perror("mmap ts file");
+		return NULL;
+	}
+
+	r->len = len;
+	r->off = store_size;
+	r->pos = pos;
+	r->ahead = store_ahead(r, 0);
+	store_populate(r->base, r->ahead);
+
+	store_size += len;
+	region_num++;
+	return (__s64 *)r->base;
+}
+
+/* regions can be bigger than RAM, don't keep them locked by mlockall */
+void store_unlock(void)
+{
+	int i;
+
+	for (i = 0; i < region_num; i++)
+		munlock(regions[i].base, regions[i].len);
+}
+
+static void store_region_flush(struct store_region *r, long page)
+{
+	size_t pos, end;
+
+	pos = (char *)*r->pos - r->base;
+
+	end = store_ahead(r, pos);
+	if (end > r->ahead) {
+		store_populate(r->base + r->ahead, end - r->ahead);
+		r->ahead = end;
+	}
+
+	if (pos < STORE_BEHIND)
+		return;
+
+	/* packets can be reordered, leave margin behind */
+	end = (pos - STORE_BEHIND) & ~(page - 1);
+	if (end <= r->done)
+		return;
+
+	if (msync(r->base + r->done, end - r->done, MS_SYNC))
+		return perror("msync ts file");
+
+	madvise(r->base + r->done, end - r->done, MADV_DONTNEED);
+	posix_fadvise(store_fd, r->off + r->done, end - r->done,
+		      POSIX_FADV_DONTNEED);
+	r->done = end;
+}
+
+/* file range for len bytes of scratch, free one if fits or new one */
+static struct store_scratch *store_scratch_get(size_t len)
+{
+	struct store_scratch *s;
+	int i, ret;
+
+	for (i = 0; i < scratch_num; i++) {
+		if (!scratch[i].used && scratch[i].len >= len) {
+			scratch[i].used = 1;
+			return &scratch[i];
+		}
+	}
+
+	s = realloc(scratch, (scratch_num + 1) * sizeof(*scratch));
+	if (!s)
+		return NULL;
+
+	scratch = s;
+	ret = posix_fallocate(store_fd, store_size, len);
+	if (ret) {
+		errno = ret;
+		perror("fallocate ts file scratch");
+		return NULL;
+	}
+
+	s = &scratch[scratch_num++];
+	s->len = len;
+	s->off = store_size;
+	s->used = 1;
+	store_size += len;
+	return s;
+}
+
+/*
+ * store_scratch - temporary vector of num ts to compute report from. With
+ * ts file it's a range of the file past ts regions, not locked, so report
+ * of run bigger than RAM is paged as its ts are, heap otherwise.
+ */
+__s64 *store_scratch(size_t num)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	struct store_scratch *s;
+	size_t len;
+	char *p;
+
+	if (store_fd < 0)
+		return malloc(num * sizeof(__s64));
+
+	len = (num * sizeof(__s64) + page - 1) & ~(page - 1);
+	if (!len)
+		len = page;
+
+	/* table can be moved by realloc, so keep it locked while s is used */
+	pthread_mutex_lock(&scratch_lock);
+	s = store_scratch_get(len);
+	if (!s) {
+		pthread_mutex_unlock(&scratch_lock);
+		return NULL;
+	}
+
+	p = mmap(NULL, s->len, PROT_READ | PROT_WRITE, MAP_SHARED, store_fd,
+		 s->off);
+	if (p == MAP_FAILED) {
+		perror("mmap ts file scratch");
+		s->used = 0;
+		pthread_mutex_unlock(&scratch_lock);
+		return NULL;
+	}
+
+	/* mlockall(MCL_FUTURE) would keep it in RAM */
+	munlock(p, s->len);
+	s->base = p;
+	pthread_mutex_unlock(&scratch_lock);
+	return (__s64 *)p;
+}
+
+void store_scratch_free(__s64 *p)
+{
+	int i;
+
+	if (store_fd < 0) {
+		free(p);
+		return;
+	}
+
+	pthread_mutex_lock(&scratch_lock);
+	for (i = 0; i < scratch_num; i++) {
+		if (scratch[i].used && scratch[i].base == (char *)p) {
+			munmap(p, scratch[i].len);
+			scratch[i].used = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&scratch_lock);
+}
+
+/* keeps write back out of measurement thread, never returns */
+void *store_flusher(void *arg)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	int i;
+
+	for (;;) {
+		for (i = 0; i < region_num; i++)
+			store_region_flush(&regions[i], page);
+
+		sleep(1);
+	}
+
+	return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef PLGET_STORE_H
+#define PLGET_STORE_H
+
+#include <stddef.h>
+#include <linux/types.h>
+
+#define STORE_REGIONS_MAX	16
+#define STORE_AHEAD		(64 << 20)	/* kept faulted in ahead */
+#define STORE_BEHIND		(1 << 20)	/* reorder margin, not flushed */
+
+/*
+ * File backed storage for raw ts vectors. Each vector is a page aligned
+ * region of the file, mapped shared and pre-faulted before measurement.
+ * While running, flusher thread keeps pages ahead of write position
+ * faulted in and writes back and drops ones behind it, so capture is not
+ * limited by RAM and no page fault happens in measurement loop.
+ */
+int store_open(char *path);
+__s64 *store_map(size_t num, __s64 **pos);
+void store_unlock(void);
+void *store_flusher(void *arg);
+__s64 *store_scratch(size_t num);
+void store_scratch_free(__s64 *p);
+
+#endif
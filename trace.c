@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <endian.h>
+#include "plget.h"
+#include "trace.h"
+
+#define TRACE_CHUNK		4096
+
+static void trace_add(struct trace_src *src, int *num, char *name,
+		      struct stats *ss)
+{
+	if (!ss->start_ts || *num == TRACE_COL_MAX)
+		return;
+
+	memset(src[*num].name, 0, TRACE_NAME_LEN);
+	strncpy(src[*num].name, name, TRACE_NAME_LEN - 1);
+	src[(*num)++].ss = ss;
+}
+
+/*
+ * trace_collect - ts vectors of the mode in trace column order,
+ * src has to be of TRACE_COL_MAX, returns number of them
+ */
+int trace_collect(struct trace_src *src)
+{
+	char name[] = "tx_sched0";
+	int mod = plget->mod;
+	int i, num = 0;
+
+	if (mod == RTT_MOD || mod == ECHO_LAT || mod == TX_LAT) {
+		trace_add(src, &num, "tx_plan", &tx_plan_v);
+		trace_add(src, &num, "tx_txtime", &tx_txtime_v);
+		trace_add(src, &num, "tx_app", &tx_app_v);
+		/* hardly more than 9 devices on the path */
+		for (i = 0; tx_sch_v && i < plget->dev_deep && i < 9; i++) {
+			name[8] = '1' + i;
+			trace_add(src, &num, name, &tx_sch_v[i]);
+		}
+
+		trace_add(src, &num, "tx_sw", &tx_sw_v);
+		trace_add(src, &num, "tx_hw", &tx_hw_v);
+	}
+
+	if (mod == RTT_MOD || mod == ECHO_LAT || mod == RX_LAT) {
+		trace_add(src, &num, "rx_app", &rx_app_v);
+		trace_add(src, &num, "rx_sw", &rx_sw_v);
+		trace_add(src, &num, "rx_hw", &rx_hw_v);
+	}
+
+	return num;
+}
+
+/* write n values of v, 0 - to pad column, tid column if v is NULL */
+static int trace_write_col(int fd, __s64 *v, __u64 n, __u64 rec_num)
+{
+	__s64 buf[TRACE_CHUNK];
+	__u64 i, j, k;
+
+	for (i = 0; i < rec_num; i += k) {
+		k = rec_num - i < TRACE_CHUNK ? rec_num - i : TRACE_CHUNK;
+		for (j = 0; j < k; j++) {
+			if (!v)
+				buf[j] = htole64(i + j);
+			else
+				buf[j] = i + j < n ? htole64(v[i + j]) : 0;
+		}
+
+		if (write(fd, buf, k * sizeof(*buf)) != k * sizeof(*buf))
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * trace_write - dump raw ts vectors in binary columnar trace, it's
+ * much faster to get and parse than text printouts on big captures
+ */
+int trace_write(char *path)
+{
+	struct trace_col col[TRACE_COL_MAX + 1];
+	struct trace_src srcs[TRACE_COL_MAX];
+	struct trace_hdr hdr = { .magic = TRACE_MAGIC };
+	__u64 n, off, rec_num = 0;
+	int fd, i, src_num;
+
+	src_num = trace_collect(srcs);
+	for (i = 0; i < src_num; i++) {
+		n = srcs[i].ss->next_ts - srcs[i].ss->start_ts;
+		if (n > rec_num)
+			rec_num = n;
+	}
+
+	hdr.version = htole32(TRACE_VERSION);
+	hdr.col_num = htole32(src_num + 1);
+	hdr.rec_num = htole64(rec_num);
+	hdr.mode = htole32(plget->mod);
+	hdr.pkt_type = htole32(plget->pkt_type);
+	hdr.frame_size = htole32(plget->frame_size);
+	hdr.dev_deep = htole32(plget->dev_deep);
+	hdr.interval = htole64((__s64)plget->interval.tv_sec * NSEC_PER_SEC +
+			       plget->interval.tv_nsec);
+	snprintf(hdr.if_name, sizeof(hdr.if_name), "%s", plget->if_name);
+
+	memset(col, 0, sizeof(col));
+	off = sizeof(hdr) + (src_num + 1) * sizeof(*col);
+	snprintf(col[0].name, TRACE_NAME_LEN, "tid");
+	col[0].off = htole64(off);
+	for (i = 0; i < src_num; i++) {
+		off += rec_num * sizeof(__s64);
+		memcpy(col[i + 1].name, srcs[i].name, TRACE_NAME_LEN);
+		col[i + 1].off = htole64(off);
+	}
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return perror("open trace"), -errno;
+
+	if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+	    write(fd, col, (src_num + 1) * sizeof(*col)) !=
+	    (src_num + 1) * sizeof(*col))
+		goto err;
+
+	if (trace_write_col(fd, NULL, 0, rec_num))
+		goto err;
+
+	for (i = 0; i < src_num; i++) {
+		n = srcs[i].ss->next_ts - srcs[i].ss->start_ts;
+		if (trace_write_col(fd, srcs[i].ss->start_ts, n, rec_num))
+			goto err;
+	}
+
+	close(fd);
+	printf("trace of %llu packets, %d columns written to %s\n", rec_num,
+	       src_num + 1, path);
+	return 0;
+
+err:
+	perror("write trace");
+	close(fd);
+	return -EIO;
+}
+
+/*
+ * trace_write_csv - same per-packet ts as text, row per tid and column per
+ * ts vector, in ns, absent ts is left empty
+ */
+int trace_write_csv(char *path)
+{
+	struct trace_src srcs[TRACE_COL_MAX];
+	__u64 n[TRACE_COL_MAX];
+	__u64 i, rec_num = 0;
+	int j, src_num;
+	__s64 ts;
+	FILE *f;
+
+	src_num = trace_collect(srcs);
+	for (j = 0; j < src_num; j++) {
+		n[j] = srcs[j].ss->next_ts - srcs[j].ss->start_ts;
+		if (n[j] > rec_num)
+			rec_num = n[j];
+	}
+
+	f = fopen(path, "w");
+	if (!f)
+		return perror("open csv"), -errno;
+
+	fprintf(f, "tid");
+	for (j = 0; j < src_num; j++)
+		fprintf(f, ",%s", srcs[j].name);
+	fprintf(f, "\n");
+
+	for (i = 0; i < rec_num; i++) {
+		fprintf(f, "%llu", i);
+		for (j = 0; j < src_num; j++) {
+			ts = i < n[j] ? srcs[j].ss->start_ts[i] : 0;
+			if (ts)
+				fprintf(f, ",%lld", ts);
+			else
+				fputc(',', f);
+		}
+		fputc('\n', f);
+	}
+
+	if (fclose(f))
+		return perror("write csv"), -EIO;
+
+	printf("csv of %llu packets, %d columns written to %s\n", rec_num,
+	       src_num + 1, path);
+	return 0;
+}
+
+/* trace_read - load trace written by trace_write(), all columns in memory */
+int trace_read(char *path, struct trace *t)
+{
+	struct trace_col col;
+	size_t size;
+	__u64 i, n;
+	int fd, c;
+
+	memset(t, 0, sizeof(*t));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return perror("open trace"), -errno;
+
+	if (read(fd, &t->hdr, sizeof(t->hdr)) != sizeof(t->hdr) ||
+	    memcmp(t->hdr.magic, TRACE_MAGIC, sizeof(t->hdr.magic)) ||
+	    le32toh(t->hdr.version) != TRACE_VERSION)
+		goto bad;
+
+	t->hdr.col_num = le32toh(t->hdr.col_num);
+	t->hdr.rec_num = le64toh(t->hdr.rec_num);
+	t->hdr.mode = le32toh(t->hdr.mode);
+	t->hdr.pkt_type = le32toh(t->hdr.pkt_type);
+	t->hdr.frame_size = le32toh(t->hdr.frame_size);
+	t->hdr.dev_deep = le32toh(t->hdr.dev_deep);
+	t->hdr.interval = le64toh(t->hdr.interval);
+	if (t->hdr.col_num > TRACE_COL_MAX + 1)
+		goto bad;
+
+	n = t->hdr.rec_num;
+	size = n * sizeof(__s64);
+	for (c = 0; c < t->hdr.col_num; c++) {
+		if (pread(fd, &col, sizeof(col), sizeof(t->hdr) +
+			  c * sizeof(col)) != sizeof(col))
+			goto bad;
+
+		memcpy(t->name[c], col.name, TRACE_NAME_LEN);
+		t->name[c][TRACE_NAME_LEN - 1] = 0;
+
+		t->col[c] = malloc(size ? size : 1);
+		if (!t->col[c]) {
+			t->col_num = c;
+			close(fd);
+			trace_free(t);
+			return -ENOMEM;
+		}
+
+		t->col_num = c + 1;
+		if (pread(fd, t->col[c], size, le64toh(col.off)) != size)
+			goto bad;
+
+		for (i = 0; i < n; i++)
+			t->col[c][i] = le64toh(t->col[c][i]);
+	}
+
+	close(fd);
+	return 0;
+
+bad:
+	fprintf(stderr, "%s: not a plget trace or truncated\n", path);
+	close(fd);
+	trace_free(t);
+	return -EINVAL;
+}
+
+/* column by name, NULL if absent */
+__s64 *trace_col(struct trace *t, char *name)
+{
+	int c;
+
+	for (c = 0; c < t->col_num; c++) {
+		if (!strcmp(t->name[c], name))
+			return t->col[c];
+	}
+
+	return NULL;
+}
+
+void trace_free(struct trace *t)
+{
+	int c;
+
+	for (c = 0; c < t->col_num; c++)
+		free(t->col[c]);
+
+	t->col_num = 0;
+}
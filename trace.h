@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef PLGET_TRACE_H
+#define PLGET_TRACE_H
+
+#include <linux/types.h>
+#include "stat.h"
+
+#define TRACE_MAGIC		"PLGTRACE"
+#define TRACE_VERSION		1
+#define TRACE_NAME_LEN		16
+#define TRACE_COL_MAX		(STATS_LINKS_MAX + 8)
+
+/*
+ * Binary per-packet trace, all fields are little endian:
+ *
+ * struct trace_hdr
+ * struct trace_col [col_num]
+ * __s64 [rec_num] for every column, in order of descriptors
+ *
+ * Column "tid" is packet id, others are ts in ns, 0 means absent ts.
+ * Offsets of columns are from the file start and 8 bytes aligned.
+ */
+struct trace_hdr {
+	char magic[8];
+	__u32 version;
+	__u32 col_num;
+	__u64 rec_num;
+	__u32 mode;		/* enum test_mod */
+	__u32 pkt_type;		/* enum pkt_type */
+	__u32 frame_size;
+	__u32 dev_deep;
+	__s64 interval;		/* tx interval, ns */
+	char if_name[TRACE_NAME_LEN];
+};
+
+struct trace_col {
+	char name[TRACE_NAME_LEN];
+	__u64 off;
+};
+
+/* ts vector of the mode and its column name */
+struct trace_src {
+	char name[TRACE_NAME_LEN];
+	struct stats *ss;
+};
+
+/* trace read back, header and columns in host endian */
+struct trace {
+	struct trace_hdr hdr;
+	int col_num;
+	char name[TRACE_COL_MAX + 1][TRACE_NAME_LEN];
+	__s64 *col[TRACE_COL_MAX + 1];
+};
+
+int trace_collect(struct trace_src *src);
+int trace_write(char *path);
+int trace_write_csv(char *path);
+int trace_read(char *path, struct trace *t);
+__s64 *trace_col(struct trace *t, char *name);
+void trace_free(struct trace *t);
+
+#endif
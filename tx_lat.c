@@ -10,7 +10,11 @@
 #include "plget.h"
 #include "stat.h"
 #include "tx_lat.h"
+#include "worst.h"
 #include "xdp_sock.h"
+#include "pkt_ring.h"
+#include "pacer.h"
+#include "burst.h"
 #include <poll.h>
 #include <unistd.h>
 #include <errno.h>
@@ -32,9 +36,10 @@ static int get_tx_tstamps(void)
 	struct scm_timestamping *tss = NULL;
 	struct msghdr *msg = &plget->msg;
 	struct sock_extended_err *serr;
-	int i, ts_type, psize;
+	int i, ts_type = SCM_TSTAMP_SND, psize;
 	struct cmsghdr *cmsg;
 	struct timespec *ts;
+	int txtime_err = 0;
 	struct stats *v;
 	__u32 ts_id;
 	char *magic;
@@ -60,6 +65,11 @@ static int get_tx_tstamps(void)
 		}
 
 		serr = (void *) CMSG_DATA(cmsg);
+		if (serr->ee_origin == SO_EE_ORIGIN_TXTIME) {
+			txtime_err = serr->ee_code;
+			continue;
+		}
+
 		if (serr->ee_errno != ENOMSG ||
 		    serr->ee_origin != SO_EE_ORIGIN_TIMESTAMPING) {
 			continue;
@@ -86,6 +96,16 @@ static int get_tx_tstamps(void)
 
 	ts_id = tid_rd();
 
+	/* packet is dropped, no more ts for it */
+	if (txtime_err) {
+		if (txtime_err == SO_EE_CODE_TXTIME_MISSED)
+			plget->txtime_missed++;
+		else
+			plget->txtime_invalid++;
+
+		return 0;
+	}
+
 	if (!tss)
 		return plget->mod == RTT_MOD ? 0 : -1;
 
@@ -95,24 +115,61 @@ static int get_tx_tstamps(void)
 			v = &tx_sch_v[i];
 			if (!stats_correct_id(v, ts_id)) {
 				stats_push_id(v, ts, ts_id);
-				return 0;
+				break;
 			}
 		}
 
-		return -1;
-	}
-
-	if (ts_correct(ts))
+		if (i == plget->dev_deep)
+			return -1;
+	} else if (ts_correct(ts)) {
 		stats_push_id(&tx_sw_v, ts, ts_id);
-	else
+	} else {
 		stats_push_id(&tx_hw_v, ts + 2, ts_id);
+	}
+
+	if (plget->worst_num)
+		worst_update(ts_id, -1);
+
 	return 0;
 }
 
-static int txlat_sendto(void)
+/* packet with launch time for SO_TXTIME, CLOCK_TAI ns */
+static int txlat_sendmsg_txtime(__u64 txtime)
+{
+	char control[CMSG_SPACE(sizeof(txtime))] = { 0 };
+	struct msghdr msg = { 0 };
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+
+	iov.iov_base = plget->pkt;
+	iov.iov_len = plget->sk_payload_size;
+
+	msg.msg_name = &plget->sk_addr;
+	msg.msg_namelen = sizeof(plget->sk_addr);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_TXTIME;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(txtime));
+	memcpy(CMSG_DATA(cmsg), &txtime, sizeof(txtime));
+
+	return sendmsg(plget->sfd, &msg, 0);
+}
+
+static int txlat_sendto(__u64 txtime)
 {
 	int ret;
 
+	if (txtime)
+		return txlat_sendmsg_txtime(txtime);
+
+	if (plget->flags & PLF_TX_RING)
+		return pkt_ring_send();
+
 	if (plget->pkt_type != PKT_XDP) {
 		ret = sendto(plget->sfd, plget->pkt, plget->sk_payload_size, 0,
 				(struct sockaddr *)&plget->sk_addr,
@@ -130,8 +187,10 @@ static int txlat_proc_packets(void)
 	int sid = plget->stream_id;
 	struct pollfd fds[2];
 	struct timespec ts;
-	int pkt_num, ret;
-	uint64_t exps;
+	int pkt_num, num, ret, i;
+	uint64_t exps, slot = 0;
+	__s64 period, plan, lag;
+	__u64 txtime = 0;
 	__u32 tx_cnt;
 
 	pkt_num = plget->pkt_num;
@@ -140,21 +199,34 @@ static int txlat_proc_packets(void)
 	*rx_cnt = 0;
 	tx_cnt = 0;
 
-	ts_num = pkt_num * (plget->dev_deep + 1);
+	/* continuous mode if no packet num */
+	ts_num = pkt_num ? pkt_num * (plget->dev_deep + 1) : ~0;
 	plget->inum = ts_num;
 
+	if (plget->burst > 1) {
+		ret = burst_init();
+		if (ret)
+			return ret;
+	}
+
 	ret = plget_start_timer();
 	if (ret)
 		return ret;
 
+	period = plget->interval.tv_sec * NSEC_PER_SEC +
+		 plget->interval.tv_nsec;
+
 	fds[0].fd = plget->sfd;
 	fds[0].events = POLLERR;
 	fds[1].fd = plget->timer_fd;
 	fds[1].events = POLLIN;
 
-	for (;;) {
+	while (!plget->stop) {
 		ret = poll(fds, 2, MAX_LATENCY);
 		if (ret <= 0) {
+			if (ret < 0 && errno == EINTR)
+				continue;
+
 			if (!ret) {
 				printf("Timed out, tx packets: %lu, ts num:"
 				       "%lu\n", (unsigned long)tx_cnt, *rx_cnt);
@@ -170,19 +242,66 @@ static int txlat_proc_packets(void)
 			if (ret < 0)
 				return perror("Couldn't read timerfd"), -errno;
 
-			if (plget->flags & PLF_PTP)
-				sid_wr(htons((tx_cnt & SEQ_ID_MASK) | sid));
+			/* packet is for first expired slot, rest are missed */
+			pacer_wait(slot);
+			plan = plget->slot0 + slot * period;
+			plget->slots_missed += exps - 1;
+			slot += exps;
+
+			/* burst packets share the slot and launch time */
+			num = plget->burst;
+			if (pkt_num && num > pkt_num - tx_cnt)
+				num = pkt_num - tx_cnt;
+
+			if (plget->txtime_lead)
+				txtime = plget->txtime0 +
+					 (slot - exps) * period;
+
+			for (i = 0; i < num; i++) {
+				stats_push_ns(&tx_plan_v, plan, tx_cnt + i);
+
+				/* launch of the slot, in realtime as other ts */
+				if (txtime)
+					stats_push_ns(&tx_txtime_v,
+						      txtime - plget->tai_off,
+						      tx_cnt + i);
+			}
+
+			if (num == 1) {
+				if (plget->flags & PLF_PTP)
+					sid_wr(htons((tx_cnt & SEQ_ID_MASK) |
+						     sid));
+
+				tid_wr(tx_cnt);
+			}
 
-			tid_wr(tx_cnt);
-			if (++tx_cnt >= pkt_num)
+			tx_cnt += num;
+			if (tx_cnt >= pkt_num && pkt_num)
 				plget_stop_timer();
 
 			/* send packet */
 			clock_gettime(CLOCK_REALTIME, &ts);
-			ret = txlat_sendto();
+			if (num > 1) {
+				ret = burst_send(tx_cnt - num, num, txtime);
+				if (ret < 0)
+					return ret;
+
+				if (ret < num)
+					printf("burst: %d of %d packets sent\n",
+					       ret, num);
+			} else {
+				ret = txlat_sendto(txtime);
+			}
+
+			for (i = 0; i < num; i++)
+				stats_push(&tx_app_v, &ts);
 
-			stats_push(&tx_app_v, &ts);
-			if (ret != plget->sk_payload_size) {
+			lag = ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec - plan;
+			if (lag >= period)
+				plget->sends_late++;
+			if (lag > plget->send_lag_max)
+				plget->send_lag_max = lag;
+			if (num == 1 && ret != plget->sk_payload_size) {
 				if (ret < 0)
 					perror("sendto");
 				else
@@ -221,7 +340,7 @@ void txlat_proc_packet(void)
 
 	/* send packet */
 	clock_gettime(CLOCK_REALTIME, &ts);
-	ret = txlat_sendto();
+	ret = txlat_sendto(0);
 
 	stats_push(&tx_app_v, &ts);
 	if (ret != plget->sk_payload_size) {
@@ -239,7 +358,8 @@ void txlat_proc_packet(void)
 				return;
 			}
 
-			perror("Some error on poll()");
+			if (errno != EINTR)
+				perror("Some error on poll()");
 			return;
 		}
 
@@ -265,6 +385,7 @@ int txlat(void)
 
 	ret = txlat_proc_packets();
 
+	burst_free();
 	close(plget->timer_fd);
 	return ret;
 }
@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "vect.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* 1.5 * 2^52, int64 -> double w/o AVX512, exact for |x| < 2^51 */
+#define MAGIC_DBL		6755399441055744.0
+#define MAGIC_INT		0x4338000000000000LL
+
+#if defined(__AVX2__)
+
+#define VECT_WIDTH		4
+
+static inline __s64 hsum_epi64(__m256i v)
+{
+	__s64 a[VECT_WIDTH];
+
+	_mm256_storeu_si256((__m256i *)a, v);
+	return a[0] + a[1] + a[2] + a[3];
+}
+
+static inline double hsum_pd(__m256d v)
+{
+	double a[VECT_WIDTH];
+
+	_mm256_storeu_pd(a, v);
+	return a[0] + a[1] + a[2] + a[3];
+}
+
+static inline __m256i load_x(const __s64 *v, size_t i)
+{
+	return _mm256_loadu_si256((const __m256i *)(v + i));
+}
+
+static inline __m256d cvt_pd(__m256i x)
+{
+	x = _mm256_add_epi64(x, _mm256_set1_epi64x(MAGIC_INT));
+	return _mm256_sub_pd(_mm256_castsi256_pd(x), _mm256_set1_pd(MAGIC_DBL));
+}
+
+static size_t vect_sum_blk(const __s64 *v, size_t n, __s64 *sum)
+{
+	__m256i acc = _mm256_setzero_si256();
+	size_t i;
+
+	for (i = 0; i + VECT_WIDTH <= n; i += VECT_WIDTH)
+		acc = _mm256_add_epi64(acc, load_x(v, i));
+
+	*sum = hsum_epi64(acc);
+	return i;
+}
+
+static size_t vect_sqdev_blk(const __s64 *v, size_t n, __s64 m, double frac,
+			     double *dev)
+{
+	__m256d acc = _mm256_setzero_pd();
+	__m256d fr = _mm256_set1_pd(frac);
+	__m256i mi = _mm256_set1_epi64x(m);
+	__m256d d;
+	size_t i;
+
+	for (i = 0; i + VECT_WIDTH <= n; i += VECT_WIDTH) {
+		d = cvt_pd(_mm256_sub_epi64(load_x(v, i), mi));
+		d = _mm256_sub_pd(d, fr);
+		acc = _mm256_add_pd(acc, _mm256_mul_pd(d, d));
+	}
+
+	*dev = hsum_pd(acc);
+	return i;
+}
+
+static size_t vect_diff_blk(const __s64 *a, const __s64 *b, __s64 *res,
+			    size_t n, size_t *cnt)
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i va, vb, z;
+	size_t i, holes = 0;
+
+	for (i = 0; i + VECT_WIDTH <= n; i += VECT_WIDTH) {
+		va = _mm256_loadu_si256((const __m256i *)(a + i));
+		vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		z = _mm256_or_si256(_mm256_cmpeq_epi64(va, zero),
+				    _mm256_cmpeq_epi64(vb, zero));
+		_mm256_storeu_si256((__m256i *)(res + i),
+				    _mm256_andnot_si256(z,
+					_mm256_sub_epi64(va, vb)));
+		holes += __builtin_popcount(_mm256_movemask_pd(
+					    _mm256_castsi256_pd(z)));
+	}
+
+	*cnt = i - holes;
+	return i;
+}
+
+#elif defined(__SSE2__)
+
+#define VECT_WIDTH		2
+
+static inline __s64 hsum_epi64(__m128i v)
+{
+	__s64 a[VECT_WIDTH];
+
+	_mm_storeu_si128((__m128i *)a, v);
+	return a[0] + a[1];
+}
+
+static inline double hsum_pd(__m128d v)
+{
+	double a[VECT_WIDTH];
+
+	_mm_storeu_pd(a, v);
+	return a[0] + a[1];
+}
+
+static inline __m128i load_x(const __s64 *v, size_t i)
+{
+	return _mm_loadu_si128((const __m128i *)(v + i));
+}
+
+static inline __m128d cvt_pd(__m128i x)
+{
+	x = _mm_add_epi64(x, _mm_set1_epi64x(MAGIC_INT));
+	return _mm_sub_pd(_mm_castsi128_pd(x), _mm_set1_pd(MAGIC_DBL));
+}
+
+/* no 64 bit compare in SSE2, both 32 bit halves have to be zero */
+static inline __m128i cmpeq0_epi64(__m128i x)
+{
+	__m128i z = _mm_cmpeq_epi32(x, _mm_setzero_si128());
+
+	return _mm_and_si128(z, _mm_shuffle_epi32(z, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+static size_t vect_sum_blk(const __s64 *v, size_t n, __s64 *sum)
+{
+	__m128i acc = _mm_setzero_si128();
+	size_t i;
+
+	for (i = 0; i + VECT_WIDTH <= n; i += VECT_WIDTH)
+		acc = _mm_add_epi64(acc, load_x(v, i));
+
+	*sum = hsum_epi64(acc);
+	return i;
+}
+
+static size_t vect_sqdev_blk(const __s64 *v, size_t n, __s64 m, double frac,
+			     double *dev)
+{
+	__m128d acc = _mm_setzero_pd();
+	__m128d fr = _mm_set1_pd(frac);
+	__m128i mi = _mm_set1_epi64x(m);
+	__m128d d;
+	size_t i;
+
+	for (i = 0; i + VECT_WIDTH <= n; i += VECT_WIDTH) {
+		d = cvt_pd(_mm_sub_epi64(load_x(v, i), mi));
+		d = _mm_sub_pd(d, fr);
+		acc = _mm_add_pd(acc, _mm_mul_pd(d, d));
+	}
+
+	*dev = hsum_pd(acc);
+	return i;
+}
+
+static size_t vect_diff_blk(const __s64 *a, const __s64 *b, __s64 *res,
+			    size_t n, size_t *cnt)
+{
+	__m128i va, vb, z;
+	size_t i, holes = 0;
+
+	for (i = 0; i + VECT_WIDTH <= n; i += VECT_WIDTH) {
+		va = _mm_loadu_si128((const __m128i *)(a + i));
+		vb = _mm_loadu_si128((const __m128i *)(b + i));
+		z = _mm_or_si128(cmpeq0_epi64(va), cmpeq0_epi64(vb));
+		_mm_storeu_si128((__m128i *)(res + i),
+				 _mm_andnot_si128(z, _mm_sub_epi64(va, vb)));
+		holes += __builtin_popcount(_mm_movemask_pd(
+					    _mm_castsi128_pd(z)));
+	}
+
+	*cnt = i - holes;
+	return i;
+}
+
+#elif defined(__ARM_NEON)
+
+#define VECT_WIDTH		2
+
+static inline int64x2_t load_x(const __s64 *v, size_t i)
+{
+	return vld1q_s64((const int64_t *)(v + i));
+}
+
+static size_t vect_sum_blk(const __s64 *v, size_t n, __s64 *sum)
+{
+	int64x2_t acc = vdupq_n_s64(0);
+	size_t i;
+
+	for (i = 0; i + VECT_WIDTH <= n; i += VECT_WIDTH)
+		acc = vaddq_s64(acc, load_x(v, i));
+
+	*sum = vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1);
+	return i;
+}
+
+#ifdef __aarch64__
+static size_t vect_sqdev_blk(const __s64 *v, size_t n, __s64 m, double frac,
+			     double *dev)
+{
+	float64x2_t acc = vdupq_n_f64(0);
+	float64x2_t fr = vdupq_n_f64(frac);
+	int64x2_t mi = vdupq_n_s64(m);
+	float64x2_t d;
+	size_t i;
+
+	for (i = 0; i + VECT_WIDTH <= n; i += VECT_WIDTH) {
+		d = vcvtq_f64_s64(vsubq_s64(load_x(v, i), mi));
+		d = vsubq_f64(d, fr);
+		acc = vfmaq_f64(acc, d, d);
+	}
+
+	*dev = vaddvq_f64(acc);
+	return i;
+}
+
+static size_t vect_diff_blk(const __s64 *a, const __s64 *b, __s64 *res,
+			    size_t n, size_t *cnt)
+{
+	int64x2_t va, vb;
+	uint64x2_t z;
+	size_t i, holes = 0;
+
+	for (i = 0; i + VECT_WIDTH <= n; i += VECT_WIDTH) {
+		va = vld1q_s64((const int64_t *)(a + i));
+		vb = vld1q_s64((const int64_t *)(b + i));
+		z = vorrq_u64(vceqzq_s64(va), vceqzq_s64(vb));
+		vst1q_s64((int64_t *)(res + i),
+			  vbicq_s64(vsubq_s64(va, vb),
+				    vreinterpretq_s64_u64(z)));
+		holes += (vgetq_lane_u64(z, 0) & 1) +
+			 (vgetq_lane_u64(z, 1) & 1);
+	}
+
+	*cnt = i - holes;
+	return i;
+}
+#else
+/* armv7 NEON has neither f64 lanes nor 64 bit compare */
+static size_t vect_sqdev_blk(const __s64 *v, size_t n, __s64 m, double frac,
+			     double *dev)
+{
+	*dev = 0;
+	return 0;
+}
+
+static size_t vect_diff_blk(const __s64 *a, const __s64 *b, __s64 *res,
+			    size_t n, size_t *cnt)
+{
+	*cnt = 0;
+	return 0;
+}
+#endif
+
+#else
+
+#define VECT_WIDTH		1
+
+static size_t vect_sum_blk(const __s64 *v, size_t n, __s64 *sum)
+{
+	*sum = 0;
+	return 0;
+}
+
+static size_t vect_sqdev_blk(const __s64 *v, size_t n, __s64 m, double frac,
+			     double *dev)
+{
+	*dev = 0;
+	return 0;
+}
+
+static size_t vect_diff_blk(const __s64 *a, const __s64 *b, __s64 *res,
+			    size_t n, size_t *cnt)
+{
+	*cnt = 0;
+	return 0;
+}
+
+#endif
+
+__s64 vect_sum(const __s64 *v, size_t n)
+{
+	__s64 sum;
+	size_t i;
+
+	for (i = vect_sum_blk(v, n, &sum); i < n; i++)
+		sum += v[i];
+
+	return sum;
+}
+
+/*
+ * Sum of (x - mean)^2, x - int(mean) is taken in integers first, so
+ * absolute ts offsets don't lose precision when converted to double.
+ */
+double vect_sqdev(const __s64 *v, size_t n, double mean)
+{
+	__s64 m = mean;
+	double frac = mean - m;
+	double dev, d;
+	size_t i;
+
+	for (i = vect_sqdev_blk(v, n, m, frac, &dev); i < n; i++) {
+		d = (double)(v[i] - m) - frac;
+		dev += d * d;
+	}
+
+	return dev;
+}
+
+/*
+ * res = a - b for entries present (not 0) in both, 0 for others, so res is
+ * indexed by packet id as a and b are. Returns number of present entries
+ */
+size_t vect_diff(const __s64 *a, const __s64 *b, __s64 *res, size_t n)
+{
+	size_t i, cnt;
+
+	for (i = vect_diff_blk(a, b, res, n, &cnt); i < n; i++) {
+		if (a[i] && b[i]) {
+			res[i] = a[i] - b[i];
+			cnt++;
+		} else {
+			res[i] = 0;
+		}
+	}
+
+	return cnt;
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef PLGET_VECT_H
+#define PLGET_VECT_H
+
+#include <stddef.h>
+#include <linux/types.h>
+
+/*
+ * Reductions over packed ns vectors. SSE2/AVX2 or NEON is used if the
+ * compiler is allowed to (-mavx2, -mfpu=neon...), scalar code otherwise.
+ */
+__s64 vect_sum(const __s64 *v, size_t n);
+double vect_sqdev(const __s64 *v, size_t n, double mean);
+size_t vect_diff(const __s64 *a, const __s64 *b, __s64 *res, size_t n);
+
+#endif
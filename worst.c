@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include "plget.h"
+#include "worst.h"
+
+/*
+ * Top-K slowest packets, kept in min-heap by span between first and last
+ * ts of the packet, so a new one has to be compared with root only. Once
+ * more ts of a kept packet arrive, its entry is updated in place.
+ */
+static struct worst_pkt *heap;
+static int heap_size;
+static int heap_num;
+
+static struct trace_src srcs[TRACE_COL_MAX];
+static int src_num;
+
+int worst_init(int num)
+{
+	heap = calloc(num, sizeof(*heap));
+	if (!heap)
+		return -ENOMEM;
+
+	heap_size = num;
+	src_num = trace_collect(srcs);
+	return 0;
+}
+
+static void worst_swap(int i, int j)
+{
+	struct worst_pkt tmp = heap[i];
+
+	heap[i] = heap[j];
+	heap[j] = tmp;
+}
+
+static void worst_sift_up(int i)
+{
+	int p;
+
+	for (; i; i = p) {
+		p = (i - 1) / 2;
+		if (heap[p].span <= heap[i].span)
+			break;
+
+		worst_swap(i, p);
+	}
+}
+
+static void worst_sift_down(int i)
+{
+	int c;
+
+	for (; (c = 2 * i + 1) < heap_num; i = c) {
+		if (c + 1 < heap_num && heap[c + 1].span < heap[c].span)
+			c++;
+
+		if (heap[i].span <= heap[c].span)
+			break;
+
+		worst_swap(i, c);
+	}
+}
+
+/* gather ts of the packet, returns stage of first ts, -1 if none */
+static int worst_fill(struct worst_pkt *p, __u32 id)
+{
+	__s64 first = 0, last = 0, v;
+	int i, f = -1;
+
+	for (i = 0; i < src_num; i++) {
+		v = stats_id_ns(srcs[i].ss, id);
+		p->ts[i] = v;
+		if (!v)
+			continue;
+
+		if (f < 0 || v < first) {
+			first = v;
+			f = i;
+		}
+
+		if (v > last)
+			last = v;
+	}
+
+	p->span = last - first;
+	return f;
+}
+
+/*
+ * worst_update - consider packet id once its ts are pushed, can be called
+ * for same id several times as ts come
+ * @cpu - cpu packet is received on, -1 if unknown
+ */
+void worst_update(__u32 id, int cpu)
+{
+	struct worst_pkt p;
+	__s64 prev;
+	int i, f;
+
+	f = worst_fill(&p, id);
+	if (f < 0)
+		return;
+
+	if (heap_num == heap_size && p.span <= heap[0].span)
+		return;
+
+	for (i = 0; i < heap_num; i++) {
+		if (heap[i].id == id)
+			break;
+	}
+
+	p.id = id;
+	p.cpu = cpu;
+	prev = stats_id_ns(srcs[f].ss, id - 1);
+	p.gap = prev ? p.ts[f] - prev : 0;
+
+	if (i < heap_num) {
+		if (cpu < 0)
+			p.cpu = heap[i].cpu;
+		heap[i] = p;
+		worst_sift_down(i);
+	} else if (heap_num < heap_size) {
+		heap[heap_num] = p;
+		worst_sift_up(heap_num++);
+	} else {
+		heap[0] = p;
+		worst_sift_down(0);
+	}
+}
+
+static int worst_cmp(const void *a, const void *b)
+{
+	const struct worst_pkt *pa = a, *pb = b;
+
+	return pa->span < pb->span ? 1 : pa->span > pb->span ? -1 : 0;
+}
+
+/*
+ * worst_print - print packets from the slowest one, ts of every packet in
+ * time order: first in ns and others as increment over previous stage
+ */
+void worst_print(FILE *f)
+{
+	int i, j, k, n, order[TRACE_COL_MAX];
+	struct worst_pkt *p;
+
+	if (!heap_num)
+		return;
+
+	qsort(heap, heap_num, sizeof(*heap), worst_cmp);
+
+	fprintf(f, "\nworst %d packets by first to last ts:\n", heap_num);
+	for (i = 0; i < heap_num; i++) {
+		p = &heap[i];
+
+		/* few present ts, insertion sort is enough */
+		for (j = 0, n = 0; j < src_num; j++) {
+			if (!p->ts[j])
+				continue;
+
+			for (k = n++; k && p->ts[order[k - 1]] > p->ts[j]; k--)
+				order[k] = order[k - 1];
+			order[k] = j;
+		}
+
+		fprintf(f, "%3d: tid %u, total %.2fus", i + 1, p->id,
+			p->span / 1000.0);
+		if (p->gap)
+			fprintf(f, ", gap %.2fus", p->gap / 1000.0);
+		if (p->cpu >= 0)
+			fprintf(f, ", rx cpu %d", p->cpu);
+
+		fprintf(f, "\n     %s %lldns", srcs[order[0]].name,
+			p->ts[order[0]]);
+		for (k = 1; k < n; k++)
+			fprintf(f, ", %s +%.2fus", srcs[order[k]].name,
+				(p->ts[order[k]] - p->ts[order[k - 1]]) /
+				1000.0);
+
+		fprintf(f, "\n");
+	}
+}
+
+/* worst_json - same packets, every present ts in ns keyed by column name */
+void worst_json(struct json *j)
+{
+	struct worst_pkt *p;
+	int i, k;
+
+	qsort(heap, heap_num, sizeof(*heap), worst_cmp);
+
+	json_arr(j, "worst");
+	for (i = 0; i < heap_num; i++) {
+		p = &heap[i];
+
+		json_obj(j, NULL);
+		json_uint(j, "tid", p->id);
+		json_int(j, "total_ns", p->span);
+		json_int(j, "gap_ns", p->gap);
+		json_int(j, "cpu", p->cpu);
+
+		json_obj(j, "ts");
+		for (k = 0; k < src_num; k++) {
+			if (p->ts[k])
+				json_int(j, srcs[k].name, p->ts[k]);
+		}
+		json_end(j);
+
+		json_end(j);
+	}
+	json_end(j);
+}
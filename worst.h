@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2019
+ * Authors:	Ivan Khoronzhuk <ivan.khoronzhuk@linaro.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef PLGET_WORST_H
+#define PLGET_WORST_H
+
+#include <stdio.h>
+#include "trace.h"
+#include "json.h"
+
+#define WORST_MAX		1024
+
+/* packet with all its ts, in trace column order, 0 - absent */
+struct worst_pkt {
+	__u32 id;
+	int cpu;		/* rx cpu, -1 if unknown */
+	__s64 span;		/* first to last ts */
+	__s64 gap;		/* from previous packet at first ts stage */
+	__s64 ts[TRACE_COL_MAX];
+};
+
+int worst_init(int num);
+void worst_update(__u32 id, int cpu);
+void worst_print(FILE *f);
+void worst_json(struct json *j);
+
+#endif